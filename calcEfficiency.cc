@@ -25,6 +25,8 @@
 
 #include "pcAdapter.h"
 #include "pcError.h"
+#include "pcControl.h"
+#include "pcVerify.h"
 
 #include <cstring>
 #include <cassert>
@@ -86,7 +88,7 @@ namespace {
       m->removeField(f);
       apf::destroyField(f);
     }
-    m->verify();
+    pc::verifyMesh(m,-1);
   }
 
   void calculateEfficiency(ph::Input src_ctrl, apf::Mesh2*& src_m,
@@ -380,6 +382,7 @@ int main(int argc, char** argv) {
   ph::Input ref_ctrl;
   ctrl.load("adapt.inp");
   ref_ctrl.load("adapt.inp");
+  pc::loadControl("adapt.inp");
   chefPhasta::initModelers(ctrl.writeSimLog);
   ref_ctrl.meshFileName = referMeshFile;
   ref_ctrl.restartFileName = referRestartDir;
@@ -390,13 +393,13 @@ int main(int argc, char** argv) {
   apf::Mesh2* m = 0;
   setupChef(ctrl, step);
   chef::cook(g, m, ctrl, grs); // used to load model and mesh
-  m->verify();
+  pc::verifyMesh(m,step);
 
   gmi_model* ref_g = 0;
   apf::Mesh2* ref_m = 0;
   setupChef(ref_ctrl, step);
   chef::cook(ref_g, ref_m, ref_ctrl, ref_grs); // used to load model and mesh
-  ref_m->verify();
+  pc::verifyMesh(ref_m,step);
 
   ctrl.rs = rs;
   ref_ctrl.rs = ref_rs;
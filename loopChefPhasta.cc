@@ -29,6 +29,9 @@
 #include "pcWriteFiles.h"
 #include "pcUpdateMesh.h"
 #include "pcAdapter.h"
+#include "pcControl.h"
+#include "pcVerify.h"
+#include "pcProximity.h"
 
 namespace {
   void freeMesh(apf::Mesh* m) {
@@ -86,6 +89,7 @@ int main(int argc, char** argv) {
   grstream grs = makeGRStream();
   ph::Input ctrl;
   ctrl.load("adapt.inp");
+  pc::loadControl("adapt.inp");
   chefPhasta::initModelers(ctrl.writeSimLog);
   /* load the model and mesh */
   gmi_model* g = 0;
@@ -100,7 +104,7 @@ int main(int argc, char** argv) {
   pc::writeSequence(m,0,"init_");
   int step = 0; int old_step = 0;
   do {
-    m->verify();
+    pc::verifyMesh(m,step);
     pass_info_to_phasta(m, ctrl);
     /*h take the initial mesh as size field */
     apf::Field* szFld = samSz::isoSize(m);
@@ -114,7 +118,9 @@ int main(int argc, char** argv) {
     if( step >= maxStep )
       break;
     setupChef(ctrl,step);
-    chef::readAndAttachFields(ctrl,m);
+    pc::readAndAttachFields(ctrl,m);
+    if (pc::stopForGap(ctrl,m,step))
+      break;
     /* perform mesh mover + improver + adapter */
     pc::updateMesh(ctrl,m,szFld,step,ctrl.simCooperation);
     chef::preprocess(m,ctrl,grs);
@@ -126,6 +132,7 @@ int main(int argc, char** argv) {
   destroyGRStream(grs);
   destroyRStream(rs);
   freeMesh(m);
+  pc::finishCheckpoints();
   chefPhasta::finalizeModelers(ctrl.writeSimLog);
   PCU_Comm_Free();
   MPI_Finalize();
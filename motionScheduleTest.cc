@@ -0,0 +1,79 @@
+#include <PCU.h>
+#include <chef.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <gmi.h>
+#include "lionPrint.h"
+
+#include "pcRigidTransform.h"
+#include "pcTimeDepMesh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* a schedule that translates the region of a box mesh must move its
+   vertices when phasta reports no rigid bodies */
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+  PCU_Comm_Init();
+  lion_set_verbosity(1);
+  apf::Mesh2* m = apf::makeMdsBox(2, 2, 2, 1.0, 1.0, 1.0, false);
+  gmi_model* g = m->getModel();
+  gmi_iter* git = gmi_begin(g, 3);
+  int tag = gmi_tag(g, gmi_next(g, git));
+  gmi_end(g, git);
+
+  const char* filename = "motion_schedule_test.txt";
+  if (!PCU_Comm_Self()) {
+    FILE* f = fopen(filename, "w");
+    fprintf(f, "body %d\n", tag);
+    fprintf(f, "table tx\n0 0\n2 0.2\nend\n");
+    fclose(f);
+  }
+  PCU_Barrier();
+  pc::loadMotionSchedule(filename, pc::getMotionSchedule());
+
+  ph::Input in;
+  in.nRigidBody = 0;
+  in.timeStepNumber = 1;
+  std::vector<pc::rigidBodyMotion> rbms = pc::getRigidBodyMotions(in);
+  int failed = 0;
+  if (rbms.size() != 1 || rbms[0].tag != tag || rbms[0].scale != 1.0) {
+    fprintf(stderr, "FAILED: schedule gave %lu motions\n", (unsigned long)rbms.size());
+    failed = 1;
+  }
+
+  std::vector<apf::MeshEntity*> verts;
+  std::vector<apf::Vector3> before;
+  apf::MeshEntity* v;
+  apf::MeshIterator* it = m->begin(0);
+  while ((v = m->iterate(it))) {
+    apf::Vector3 p;
+    m->getPoint(v, 0, p);
+    verts.push_back(v);
+    before.push_back(p);
+  }
+  m->end(it);
+  if (!failed)
+    pc::moveRigidBodies(m, rbms);
+  for (size_t i = 0; i < verts.size() && !failed; i++) {
+    apf::Vector3 p;
+    m->getPoint(verts[i], 0, p);
+    apf::Vector3 d = p - before[i];
+    if (fabs(d[0] - 0.1) > 1e-12 || fabs(d[1]) > 1e-12 || fabs(d[2]) > 1e-12) {
+      fprintf(stderr, "FAILED: vertex moved by (%g, %g, %g), expected (0.1, 0, 0)\n",
+          d[0], d[1], d[2]);
+      failed = 1;
+    }
+  }
+  failed = PCU_Max_Int(failed);
+  if (!failed && !PCU_Comm_Self())
+    printf("motion schedule moved %lu vertices\n", (unsigned long)verts.size());
+
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+  return failed;
+}
@@ -2,7 +2,13 @@
 #include "pcError.h"
 #include "pcUpdateMesh.h"
 #include "pcSmooth.h"
+#include "pcSizePipeline.h"
+#include "pcControl.h"
 #include "pcWriteFiles.h"
+#include "pcClassification.h"
+#include "pcBLStacks.h"
+#include "pcLog.h"
+#include "pcVerify.h"
 #include <SimUtil.h>
 #include <SimPartitionedMesh.h>
 #include <SimDiscrete.h>
@@ -20,6 +26,7 @@
 #include <apfShape.h>
 #include <math.h>
 #include <ctime>
+#include <unordered_map>
 
 extern void MSA_setBLSnapping(pMSAdapt, int onoff);
 extern void MSA_setAdaptExtrusion(pMSAdapt, int onoff);
@@ -125,7 +132,7 @@ namespace pc {
       m->removeField(f);
       apf::destroyField(f);
     }
-    m->verify();
+    pc::verifyMesh(m,-1);
   }
 
   int getSimFields(apf::Mesh2*& m, int simFlag, pField* sim_flds, phSolver::Input& inp) {
@@ -193,25 +200,11 @@ namespace pc {
     if(m->findField("frames")) apf::destroyField(m->findField("frames"));
   }
 
-  void attachCurrentSizeField(apf::Mesh2*& m) {
+  void getCurrentSizeSources(apf::Mesh2* m, std::vector<apf::MeshEntity*>& elms,
+      std::vector<apf::MeshEntity*>& from) {
     int  nsd = m->getDimension();
-    if(m->findField("cur_size")) apf::destroyField(m->findField("cur_size"));
-    apf::Field* cur_size = apf::createField(m, "cur_size", apf::SCALAR, apf::getConstant(nsd));
-    // loop over non-BL elements
-    apf::MeshEntity* e;
-    apf::MeshIterator* eit = m->begin(nsd);
-    while ((e = m->iterate(eit))) {
-      pRegion meshRegion = reinterpret_cast<pRegion>(e);
-      if (EN_isBLEntity(meshRegion)) continue;
-      // set mesh size field
-      double h = 0.0;
-      if (m->getType(e) == apf::Mesh::TET)
-        h = apf::computeShortestHeightInTet(m,e) * sqrt(3.0);
-      else
-        h = pc::getShortestEdgeLength(m,e);
-      apf::setScalar(cur_size, e, 0, h);
-    }
-    m->end(eit);
+    elms.clear();
+    from.clear();
 
     // get sim model
     apf::MeshSIM* sim_m = dynamic_cast<apf::MeshSIM*>(m);
@@ -220,189 +213,66 @@ namespace pc {
 
     gmi_model* gmiModel = sim_m->getModel();
     pGModel model = gmi_export_sim(gmiModel);
+    blStackIndex& stacks = getBLStackIndex(model, pm);
 
-    // loop over model faces
-    pGFace modelFace;
-    pFace meshFace;
-    pFace blFace;
-    pRegion blRegion;
-    FIter fIter;
-    pEntity seed;
-    pPList growthRegions = PList_new();
-    pPList growthFaces = PList_new();
-    GFIter gfIter = GM_faceIter(model);
-    while((modelFace=GFIter_next(gfIter))){
-      // loop over mesh faces on model face
-      fIter = M_classifiedFaceIter(pm, modelFace, 1);
-      while((meshFace = FIter_next(fIter))){
-        apf::MeshEntity* apf_f = reinterpret_cast<apf::MeshEntity*>(meshFace);
-        // check if BL base
-        if (BL_isBaseEntity(meshFace, modelFace)) {
-          // loop over BL regions and layers
-          for(int faceSide = 0; faceSide < 2; faceSide++){
-            int hasSeed = BL_stackSeedEntity(meshFace, modelFace, faceSide, NULL, &seed);
-            if (hasSeed) {
-              BL_growthRegionsAndLayerFaces((pRegion)seed, growthRegions, growthFaces, Layer_Entity);
-              if (PList_size(growthRegions) >= (PList_size(growthFaces)-1)*3) { // tet
-                for(int i = 0; i < PList_size(growthFaces); i++) {
-                  blFace = (pFace)PList_item(growthFaces,i);
-                  apf::MeshEntity* apf_f = reinterpret_cast<apf::MeshEntity*>(blFace);
-                  double h = apf::computeShortestHeightInTri(m,apf_f) * sqrt(2.0);
-                  for(int j = 0; j < 3; j++) {
-                    if (i*3+j == PList_size(growthRegions)) break;
-                    blRegion = (pRegion)PList_item(growthRegions,i*3+j);
-                    // set mesh size field
-                    apf::MeshEntity* apf_r = reinterpret_cast<apf::MeshEntity*>(blRegion);
-                    apf::setScalar(cur_size, apf_r, 0, h);
-                  }
-                }
-              }
-              else if (PList_size(growthRegions) >= (PList_size(growthFaces)-1)) { // wedge
-                for(int i = 0; i < PList_size(growthFaces); i++) {
-                  if (i == PList_size(growthRegions)) break;
-                  blFace = (pFace)PList_item(growthFaces,i);
-                  apf::MeshEntity* apf_f = reinterpret_cast<apf::MeshEntity*>(blFace);
-                  double h = apf::computeShortestHeightInTri(m,apf_f) * sqrt(2.0);
-                  blRegion = (pRegion)PList_item(growthRegions,i);
-                  // set mesh size field
-                  apf::MeshEntity* apf_r = reinterpret_cast<apf::MeshEntity*>(blRegion);
-                  apf::setScalar(cur_size, apf_r, 0, h);
-                }
-              }
-            }
-            else if (hasSeed < 0) {
-              printf("not support blending BL mesh or miss some info!\n");
-              exit(0);
-            }
-          }
-        }
-      }
-      FIter_delete(fIter);
+    // non-BL elements, and BL ones too if some stacks are blended
+    std::unordered_map<apf::MeshEntity*, size_t> index;
+    apf::MeshEntity* e;
+    apf::MeshIterator* eit = m->begin(nsd);
+    while ((e = m->iterate(eit))) {
+      pRegion meshRegion = reinterpret_cast<pRegion>(e);
+      index[e] = elms.size();
+      elms.push_back(e);
+      from.push_back((!stacks.numBlended && EN_isBLEntity(meshRegion)) ? 0 : e);
     }
-    GFIter_delete(gfIter);
-  }
+    m->end(eit);
 
-  double estimateAdaptedMeshElements(apf::Mesh2*& m, apf::Field* sizes) {
-    attachCurrentSizeField(m);
-    apf::Field* cur_size = m->findField("cur_size");
-    assert(cur_size);
-
-    double estElm = 0.0;
-    apf::Vector3 v_mag  = apf::Vector3(0.0, 0.0, 0.0);
-    int num_dims = m->getDimension();
-    assert(num_dims == 3); // only work for 3D mesh
-    apf::Vector3 xi = apf::Vector3(0.25, 0.25, 0);
-    apf::MeshEntity* en;
-    apf::MeshIterator* eit = m->begin(num_dims);
-    while ((en = m->iterate(eit))) {
-      apf::MeshElement* elm = apf::createMeshElement(m,en);
-      apf::Element* fd_elm = apf::createElement(sizes,elm);
-      apf::getVector(fd_elm,xi,v_mag);
-      double h_old = apf::getScalar(cur_size,en,0);
-      if(EN_isBLEntity(reinterpret_cast<pEntity>(en))) {
-        estElm = estElm + (h_old/v_mag[0])*(h_old/v_mag[0]);
+    // BL stacks and layers
+    for (size_t s = 0; s < stacks.size(); s++) {
+      pFace const* growthFaces = &stacks.faces[stacks.faceStart[s]];
+      pRegion const* growthRegions = &stacks.regions[stacks.regionStart[s]];
+      int numFaces = stacks.numFaces(s);
+      int numRegions = stacks.numRegions(s);
+      if (numRegions >= (numFaces-1)*3) { // tet
+        for(int i = 0; i < numFaces; i++) {
+          apf::MeshEntity* apf_f = reinterpret_cast<apf::MeshEntity*>(growthFaces[i]);
+          for(int j = 0; j < 3; j++) {
+            if (i*3+j == numRegions) break;
+            apf::MeshEntity* apf_r = reinterpret_cast<apf::MeshEntity*>(growthRegions[i*3+j]);
+            from[index[apf_r]] = apf_f;
+          }
+        }
       }
-      else {
-        estElm = estElm + (h_old/v_mag[0])*(h_old/v_mag[0])*(h_old/v_mag[0]);
+      else if (numRegions >= (numFaces-1)) { // wedge
+        for(int i = 0; i < numFaces; i++) {
+          if (i == numRegions) break;
+          apf::MeshEntity* apf_f = reinterpret_cast<apf::MeshEntity*>(growthFaces[i]);
+          apf::MeshEntity* apf_r = reinterpret_cast<apf::MeshEntity*>(growthRegions[i]);
+          from[index[apf_r]] = apf_f;
+        }
       }
     }
-    m->end(eit);
-
-    apf::destroyField(cur_size);
-
-    double estTolElm = PCU_Add_Double(estElm);
-    return estTolElm;
   }
 
-  void initializeCtCn(apf::Mesh2*& m) {
-    apf::Field* ctcn = apf::createSIMFieldOn(m, "ctcn_elm", apf::SCALAR);
-    apf::MeshEntity* v;
-    apf::MeshIterator* vit = m->begin(0);
-    while ((v = m->iterate(vit))) {
-      apf::setScalar(ctcn,v,0,1.0);
-    }
-    m->end(vit);
+  double measureCurrentSize(apf::Mesh* m, apf::MeshEntity* e, apf::MeshEntity* from) {
+    if (!from)
+      return 0.0;
+    if (from != e)
+      return apf::computeShortestHeightInTri(m,from) * sqrt(2.0);
+    if (m->getType(e) == apf::Mesh::TET)
+      return apf::computeShortestHeightInTet(m,e) * sqrt(3.0);
+    return pc::getShortestEdgeLength(m,e);
   }
 
-  void applyMaxSizeBound(apf::Mesh2*& m, apf::Field* sizes, ph::Input& in) {
-    apf::Vector3 v_mag = apf::Vector3(0.0,0.0,0.0);
-    apf::MeshEntity* v;
-    apf::MeshIterator* vit = m->begin(0);
-    while ((v = m->iterate(vit))) {
-      apf::getVector(sizes,v,0,v_mag);
-      for (int i = 0; i < 3; i++)
-        if(v_mag[i] > in.simSizeUpperBound)
-          v_mag[i] = in.simSizeUpperBound;
-      apf::setVector(sizes,v,0,v_mag);
-    }
-    m->end(vit);
-  }
-
-  double applyMaxNumberElement(apf::Mesh2*& m, apf::Field* sizes, ph::Input& in)  {
-    /* scale mesh if number of elements exceeds threshold */
-    double N_est = estimateAdaptedMeshElements(m, sizes);
-    double cn = N_est / (double)in.simMaxAdaptMeshElements;
-    cn = (cn>1.0)?cbrt(cn):1.0;
-    if(!PCU_Comm_Self())
-      printf("Estimated No. of Elm: %f and c_N = %f\n", N_est, cn);
-    apf::Field* sol = m->findField("solution");
-    apf::Field* ctcn = m->findField("ctcn_elm");
-    assert(sol);
-    assert(ctcn);
-    apf::Vector3 v_mag = apf::Vector3(0.0,0.0,0.0);
-    apf::MeshEntity* v;
-    apf::MeshIterator* vit = m->begin(0);
-    while ((v = m->iterate(vit))) {
-      apf::getVector(sizes,v,0,v_mag);
-      for (int i = 0; i < 3; i++)
-        v_mag[i] = v_mag[i] * cn;
-      apf::setVector(sizes,v,0,v_mag);
-
-      double f = apf::getScalar(ctcn,v,0);
-      f = f * cn;
-      apf::setScalar(ctcn,v,0,f);
-    }
-    m->end(vit);
-    return cn;
-  }
-
-  void applyMaxTimeResource(apf::Mesh2*& m, apf::Field* sizes,
-                            ph::Input& in, phSolver::Input& inp) {
-    apf::Field* sol = m->findField("solution");
-    apf::Field* ctcn = m->findField("ctcn_elm");
-    assert(sol);
-    assert(ctcn);
-    apf::Vector3 v_mag = apf::Vector3(0.0,0.0,0.0);
-    apf::NewArray<double> s(in.ensa_dof);
-    double maxCt = 1.0;
-    double minCtH = 1.0e16;
-    apf::MeshEntity* v;
-    apf::MeshIterator* vit = m->begin(0);
-    while ((v = m->iterate(vit))) {
-      apf::getComponents(sol, v, 0, &s[0]);
-      double u = sqrt(s[1]*s[1]+s[2]*s[2]+s[3]*s[3]);
-      double c = sqrt(1.4*8.3145*s[4]/0.029); // ideal air assumed here
-      double t = inp.GetValue("Time Step Size");
-      double h_min = (u+c)*t/in.simCFLUpperBound;
-      if (h_min < in.simSizeLowerBound) h_min = in.simSizeLowerBound;
-      apf::getVector(sizes,v,0,v_mag);
-      double f = apf::getScalar(ctcn,v,0);
-      for (int i = 0; i < 3; i++) {
-        if(v_mag[i] < h_min) {
-          if(h_min/(v_mag[i]) > maxCt) maxCt = h_min/(v_mag[i]);
-          apf::setScalar(ctcn,v,0,h_min/v_mag[i]*f);
-          if(h_min < minCtH) minCtH = h_min;
-          v_mag[i] = h_min;
-        }
-      }
-      apf::setVector(sizes,v,0,v_mag);
-    }
-    m->end(vit);
-
-    double maxCtAll  = PCU_Max_Double(maxCt);
-    double minCtHAll = PCU_Min_Double(minCtH);
-    if (!PCU_Comm_Self())
-      printf("max time resource bound factor and min reached size: %f and %f\n",maxCtAll,minCtHAll);
+  void attachCurrentSizeField(apf::Mesh2*& m) {
+    int  nsd = m->getDimension();
+    if(m->findField("cur_size")) apf::destroyField(m->findField("cur_size"));
+    apf::Field* cur_size = apf::createField(m, "cur_size", apf::SCALAR, apf::getConstant(nsd));
+    std::vector<apf::MeshEntity*> elms, from;
+    getCurrentSizeSources(m, elms, from);
+    for (size_t i = 0; i < elms.size(); i++)
+      if (from[i])
+        apf::setScalar(cur_size, elms[i], 0, measureCurrentSize(m, elms[i], from[i]));
   }
 
   void syncMeshSize(apf::Mesh2*& m, apf::Field* sizes) {
@@ -460,30 +330,14 @@ namespace pc {
     apf::Field* sizes = m->findField("sizes");
     assert(sizes);
 
-    /* initial ctcn field */
-    pc::initializeCtCn(m);
-
-    /* apply upper bound */
-    pc::applyMaxSizeBound(m, sizes, in);
-
-    /* apply max number of element */
-    double cn = pc::applyMaxNumberElement(m, sizes, in);
-
-    /* scale mesh if reach time resource bound */
-    pc::applyMaxTimeResource(m, sizes, in, inp);
-
-    /* apply upper bound */
-    pc::applyMaxSizeBound(m, sizes, in);
-
-    /* add mesh smooth/gradation function here */
-    pc::addSmoother(m, in.gradingFactor);
+    /* bound, budget, time resource and gradation stages */
+    pc::runSizePipeline(m, in, inp, parseSizeStages(getControl().sizeStages));
 
     /* sync mesh size over partitions */
 //    pc::syncMeshSize(m, sizes);
 
     /* use current size field */
-    if(!PCU_Comm_Self())
-      printf("Start mesh adapt of setting size field\n");
+    PC_LOG(PC_LOG_INFO, "Start mesh adapt of setting size field\n");
 
     apf::Vector3 v_mag = apf::Vector3(0.0,0.0,0.0);
     apf::MeshEntity* v;
@@ -510,8 +364,7 @@ namespace pc {
     }
     m->end(vit);
 
-    if(!PCU_Comm_Self())
-      printf("Size field hacked\n");
+    PC_LOG(PC_LOG_INFO, "Size field hacked\n");
     /* write error and mesh size */
     pc::writeSequence(m, in.timeStepNumber, "error_mesh_size_");
 
@@ -546,8 +399,7 @@ namespace pc {
       pVertex meshVertex;
 
       /* create the Simmetrix adapter */
-      if(!PCU_Comm_Self())
-        printf("Start mesh adapt\n");
+      PC_LOG(PC_LOG_INFO, "Start mesh adapt\n");
       pMSAdapt adapter = MSA_new(sim_pm, 1);
       pPList sim_fld_lst = PList_new();
       setupSimAdapter(adapter, in, m, sim_fld_lst);
@@ -561,8 +413,7 @@ namespace pc {
 
 
       /* run the adapter */
-      if(!PCU_Comm_Self())
-        printf("do real mesh adapt\n");
+      PC_LOG(PC_LOG_INFO, "do real mesh adapt\n");
       MSA_adapt(adapter, progress);
       MSA_delete(adapter);
 
@@ -578,6 +429,7 @@ namespace pc {
       /* run the improver */
       VolumeMeshImprover_execute(vmi, progress);
       VolumeMeshImprover_delete(vmi);
+      pc::markTopologyChanged();
 
       PList_clear(sim_fld_lst);
       PList_delete(sim_fld_lst);
@@ -586,9 +438,8 @@ namespace pc {
       pc::balanceEqualWeights(sim_pm, progress);
 
       /* write mesh */
-      if(!PCU_Comm_Self())
-        printf("write mesh after mesh adaptation\n");
-      writeSIMMesh(sim_pm, in.timeStepNumber, "sim_mesh_");
+      PC_LOG(PC_LOG_INFO, "write mesh after mesh adaptation\n");
+      checkpointSIMMesh(sim_pm, in.timeStepNumber, "sim_mesh_");
       Progress_delete(progress);
 
       /* transfer data back to apf */
@@ -602,8 +453,9 @@ namespace pc {
       /* do SCOREC mesh adaptation */
       chef::adapt(m,szFld,in);
       chef::balance(in,m);
+      pc::markTopologyChanged();
     }
-    m->verify();
+    pc::verifyMesh(m,step);
   }
 
 }
@@ -10,6 +10,7 @@
 #include <chef.h>
 #include <phasta.h>
 #include <MeshSimAdapt.h>
+#include <vector>
 
 namespace pc {
 
@@ -27,6 +28,14 @@ namespace pc {
 
   void transferSimFields(apf::Mesh2*& m);
 
+  /* per element, in iteration order, the entity its cur_size is measured
+     on: the element, the growth face of its layer in a boundary layer
+     stack, or 0 for a BL element of no stack, which gets no size */
+  void getCurrentSizeSources(apf::Mesh2* m, std::vector<apf::MeshEntity*>& elms,
+      std::vector<apf::MeshEntity*>& from);
+
+  double measureCurrentSize(apf::Mesh* m, apf::MeshEntity* e, apf::MeshEntity* from);
+
   void attachCurrentSizeField(apf::Mesh2*& m);
 
   void setupSimImprover(pVolumeMeshImprover vmi, pPList sim_fld_lst);
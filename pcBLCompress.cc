@@ -0,0 +1,206 @@
+#include "pcBLCompress.h"
+#include "pcBLStacks.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcProximity.h"
+#include "pcRigidTransform.h"
+#include <SimPartitionedMesh.h>
+#include <SimAdvMeshing.h>
+#include "SimModel.h"
+#include "gmi_sim.h"
+#include <PCU.h>
+#include <gmi.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <unordered_set>
+
+namespace pc {
+
+  /* index of the body whose closure holds e, bodies.size() for the
+     static faces, -1 for more than one body */
+  static int ownerOf(gmi_model* g, gmi_ent* e, std::vector<gmi_ent*> const& bodies) {
+    int found = (int)bodies.size();
+    for (size_t i = 0; i < bodies.size(); i++) {
+      if (!gmi_is_in_closure_of(g, e, bodies[i]))
+        continue;
+      if (found != (int)bodies.size())
+        return -1;
+      found = (int)i;
+    }
+    return found;
+  }
+
+  /* whether a and b are one vertex, where a curve ends, or are joined
+     by an edge */
+  static bool joined(apf::Mesh* m, pVertex a, pVertex b) {
+    if (a == b)
+      return true;
+    apf::MeshEntity* ev[2] = {reinterpret_cast<apf::MeshEntity*>(a),
+                              reinterpret_cast<apf::MeshEntity*>(b)};
+    return apf::findUpward(m, apf::Mesh::EDGE, ev) != 0;
+  }
+
+  /* the three growth curves of a stack from the vertices of its base up:
+     the vertices of each layer face are matched to the curves by the
+     only pairing with every pair joined, so the diagonal of a
+     tetrahedralized layer, which also joins the two layers, is never
+     taken for a growth edge. The curves are empty if a layer has no
+     such pairing or more than one */
+  static void walkStack(apf::Mesh* m, pFace base, pFace const* layerFaces,
+      int numFaces, std::vector<pVertex> (&curves)[3]) {
+    static const int perms[6][3] = {
+      {0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0}};
+    for (int j = 0; j < 3; j++)
+      curves[j].assign(1, F_vertex(base, j));
+    for (int f = 1; f < numFaces; f++) {
+      pVertex next[3];
+      for (int j = 0; j < 3; j++)
+        next[j] = F_vertex(layerFaces[f], j);
+      int found = -1;
+      for (int p = 0; p < 6; p++) {
+        bool all = true;
+        for (int j = 0; j < 3 && all; j++)
+          all = joined(m, curves[j].back(), next[perms[p][j]]);
+        if (!all)
+          continue;
+        if (found >= 0) {
+          found = -1;
+          break;
+        }
+        found = p;
+      }
+      if (found < 0) {
+        for (int j = 0; j < 3; j++)
+          curves[j].clear();
+        return;
+      }
+      for (int j = 0; j < 3; j++)
+        curves[j].push_back(next[perms[found][j]]);
+    }
+  }
+
+  /* squeeze the layers of curve above the ones within keep of the base
+     into the thickness room, carried along by motion if it is set; false
+     if the curve already fits or a vertex to move is not interior to a
+     region or is on a part boundary, where the stack of the other copy
+     may not be seen */
+  static bool compressCurve(apf::Mesh* m, rigidTransform const* motion,
+      std::vector<pVertex> const& curve, double room, double keep,
+      double& scale, blTargets& targets) {
+    size_t n = curve.size();
+    std::vector<apf::Vector3> x(n);
+    std::vector<double> s(n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(reinterpret_cast<apf::MeshEntity*>(curve[i]), 0, x[i]);
+      if (i)
+        s[i] = s[i-1] + (x[i] - x[i-1]).getLength();
+    }
+    if (s[n-1] <= room)
+      return false;
+    size_t k = 0;
+    while (k + 1 < n && s[k+1] <= keep * room)
+      k++;
+    for (size_t i = k + 1; i < n; i++)
+      if (EN_whatInType(curve[i]) != 3 ||
+          m->isShared(reinterpret_cast<apf::MeshEntity*>(curve[i])))
+        return false;
+    scale = (room - s[k]) / (s[n-1] - s[k]);
+    for (size_t i = k + 1; i < n; i++) {
+      apf::Vector3 p = x[k] + (x[i] - x[k]) * scale;
+      if (motion) {
+        double* const xp[3] = {&p[0], &p[1], &p[2]};
+        applyRigidTransform(*motion, 1, xp, xp);
+      }
+      targets[reinterpret_cast<apf::MeshEntity*>(curve[i])] = p;
+    }
+    return true;
+  }
+
+  long compressBLForGaps(ph::Input& in, apf::Mesh2* m, blTargets& targets) {
+    control const& c = getControl();
+    if (c.blGapFraction <= 0 || !in.simmetrixMesh)
+      return 0;
+    std::vector<rigidBodyMotion> rbms = getRigidBodyMotions(in);
+    if (rbms.empty())
+      return 0;
+    double t0 = PCU_Time();
+    std::vector<gapSurface> const& surfaces = movedSurfaces(m, rbms);
+    std::vector<rigidTransform> transforms(rbms.size());
+    gmi_model* g = m->getModel();
+    std::vector<gmi_ent*> bodies(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++) {
+      transforms[i] = makeRigidTransform(rbms[i]);
+      bodies[i] = gmi_find(g, 3, rbms[i].tag);
+      assert(bodies[i]);
+    }
+
+    apf::MeshSIM* sim_m = dynamic_cast<apf::MeshSIM*>(m);
+    pMesh pm = PM_mesh(sim_m->getMesh(), 0);
+    pGModel model = gmi_export_sim(g);
+
+    long numCurves = 0;
+    long numCompressed = 0;
+    long numSkipped = 0;
+    double minScale = 1.0;
+    std::unordered_set<pVertex> done; // keyed by the first vertex off the base
+    std::vector<pVertex> curves[3];
+    std::map<pGFace, int> ownerOfFace;
+    blStackIndex& stacks = getBLStackIndex(model, pm);
+    for (size_t st = 0; st < stacks.size(); st++) {
+      if (stacks.numFaces(st) < 2) continue;
+      pGFace modelFace = stacks.modelFace[st];
+      std::map<pGFace, int>::iterator oit = ownerOfFace.find(modelFace);
+      if (oit == ownerOfFace.end())
+        oit = ownerOfFace.insert(std::make_pair(modelFace,
+              ownerOf(g, reinterpret_cast<gmi_ent*>(modelFace), bodies))).first;
+      int own = oit->second;
+      if (own < 0) continue;
+      walkStack(m, stacks.base[st], &stacks.faces[stacks.faceStart[st]],
+          stacks.numFaces(st), curves);
+      for (int j = 0; j < 3; j++) {
+        std::vector<pVertex> const& curve = curves[j];
+        if (curve.size() < 2) {
+          numSkipped++;
+          continue;
+        }
+        if (!done.insert(curve[1]).second) continue;
+        numCurves++;
+        /* room from the base, where it will be after the motion, to the
+           nearest point of another surface */
+        double base[3];
+        V_coord(curve[0], base);
+        if (own < (int)rbms.size()) {
+          double* const xp[3] = {base, base + 1, base + 2};
+          applyRigidTransform(transforms[own], 1, xp, xp);
+        }
+        double gap = DBL_MAX;
+        for (size_t b = 0; b < surfaces.size(); b++)
+          if ((int)b != own && b < rbms.size())
+            gap = std::min(gap, pointDistance(surfaces[b], base));
+        if (own < (int)rbms.size())
+          gap = std::min(gap, pointDistance(surfaces.back(), base));
+        if (gap == DBL_MAX) continue;
+        double scale = 1.0;
+        rigidTransform const* motion =
+          own < (int)rbms.size() ? &transforms[own] : 0;
+        if (compressCurve(m, motion, curve, c.blGapFraction * gap,
+              c.blKeepFraction, scale, targets)) {
+          numCompressed++;
+          minScale = std::min(minScale, scale);
+        }
+      }
+    }
+    minScale = PCU_Min_Double(minScale);
+    double t1 = PCU_Time();
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "boundary layer growth curves", numCurves);
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "broken boundary layer growth curves", numSkipped);
+    long total = PCU_Add_Long(numCompressed);
+    PC_LOG(PC_LOG_INFO, "compressed %ld boundary layer growth curves, outer layers down to %f, in %f seconds\n",
+        total, minScale, t1 - t0);
+    return total;
+  }
+
+}
@@ -0,0 +1,26 @@
+#ifndef PC_BL_COMPRESS_H
+#define PC_BL_COMPRESS_H
+
+#include "pcUpdateMesh.h"
+#include <apfMesh2.h>
+#include <unordered_map>
+
+namespace pc {
+
+  /* final position, after the motion, of the compressed stack vertices */
+  typedef std::unordered_map<apf::MeshEntity*, apf::Vector3> blTargets;
+
+  /* collective, Simmetrix meshes only; measures the room of every
+     boundary layer growth curve as the distance from its base, where it
+     will be after the pending rigid body motion, to the nearest other
+     surface in any direction, not along the curve. Where the stack is
+     thicker than pcBLGapFraction of it, its outer layers are squeezed
+     toward the inner ones that fit. Both sides of a gap are treated
+     alike. Nothing is moved here: targets gets the final positions, for
+     the mover to prescribe as volume moves. Returns the number of curves
+     compressed on all parts */
+  long compressBLForGaps(ph::Input& in, apf::Mesh2* m, blTargets& targets);
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include "pcBLStacks.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include <SimAdvMeshing.h>
+#include <PCU.h>
+
+namespace pc {
+
+  static void buildBLStackIndex(blStackIndex& idx, pGModel model, pMesh pm) {
+    idx.mesh = pm;
+    idx.numBlended = 0;
+    idx.modelFace.clear();
+    idx.base.clear();
+    idx.regionStart.assign(1, 0);
+    idx.regions.clear();
+    idx.faceStart.assign(1, 0);
+    idx.faces.clear();
+    pPList growthRegions = PList_new();
+    pPList growthFaces = PList_new();
+    pGFace modelFace;
+    GFIter gfIter = GM_faceIter(model);
+    while((modelFace=GFIter_next(gfIter))){
+      pFace meshFace;
+      FIter fIter = M_classifiedFaceIter(pm, modelFace, 1);
+      while((meshFace = FIter_next(fIter))){
+        if (!BL_isBaseEntity(meshFace, modelFace)) continue;
+        for (int faceSide = 0; faceSide < 2; faceSide++) {
+          pEntity seed;
+          int hasSeed = BL_stackSeedEntity(meshFace, modelFace, faceSide, NULL, &seed);
+          if (hasSeed < 0)
+            idx.numBlended++;
+          if (hasSeed <= 0) continue;
+          PList_clear(growthRegions);
+          PList_clear(growthFaces);
+          BL_growthRegionsAndLayerFaces((pRegion)seed, growthRegions, growthFaces, Layer_Entity);
+          idx.modelFace.push_back(modelFace);
+          idx.base.push_back(meshFace);
+          for (int i = 0; i < PList_size(growthRegions); i++)
+            idx.regions.push_back((pRegion)PList_item(growthRegions, i));
+          idx.regionStart.push_back((int)idx.regions.size());
+          for (int i = 0; i < PList_size(growthFaces); i++)
+            idx.faces.push_back((pFace)PList_item(growthFaces, i));
+          idx.faceStart.push_back((int)idx.faces.size());
+        }
+      }
+      FIter_delete(fIter);
+    }
+    GFIter_delete(gfIter);
+    PList_delete(growthRegions);
+    PList_delete(growthFaces);
+    idx.epoch = getTopologyEpoch();
+  }
+
+  blStackIndex& getBLStackIndex(pGModel model, pMesh pm) {
+    static blStackIndex idx;
+    if (idx.epoch != getTopologyEpoch() || idx.mesh != pm) {
+      double t0 = PCU_Time();
+      buildBLStackIndex(idx, model, pm);
+      double t1 = PCU_Time();
+      if (idx.numBlended)
+        PC_LOG_ALL(PC_LOG_WARN, "%ld blended boundary layer stacks not indexed\n", idx.numBlended);
+      PC_LOG_TOTAL(PC_LOG_DEBUG, "boundary layer stacks", (long)idx.size());
+      PC_LOG(PC_LOG_INFO, "built boundary layer stack index in %f seconds\n", t1 - t0);
+    }
+    return idx;
+  }
+
+}
@@ -0,0 +1,34 @@
+#ifndef PC_BL_STACKS_H
+#define PC_BL_STACKS_H
+
+#include <SimPartitionedMesh.h>
+#include "SimModel.h"
+#include <vector>
+
+namespace pc {
+
+  /* the boundary layer stacks of a part as flat arrays, one stack per
+     base face and side with a seed, built once per topology epoch */
+  struct blStackIndex {
+    blStackIndex(): epoch(-1), mesh(0), numBlended(0) {}
+    long epoch;
+    pMesh mesh;
+    long numBlended;               // blended stacks, not indexed
+    std::vector<pGFace> modelFace; // per stack, the model face of its base
+    std::vector<pFace> base;       // per stack, the base face
+    std::vector<int> regionStart;  // regions of stack s: regions[regionStart[s]] ..
+    std::vector<pRegion> regions;
+    std::vector<int> faceStart;    // layer faces of stack s from the base: faces[faceStart[s]] ..
+    std::vector<pFace> faces;
+    size_t size() const { return base.size(); }
+    int numRegions(size_t s) const { return regionStart[s+1] - regionStart[s]; }
+    int numFaces(size_t s) const { return faceStart[s+1] - faceStart[s]; }
+  };
+
+  /* returns the cached index, rebuilding it if the topology epoch or
+     the mesh changed; blended stacks are counted and warned about */
+  blStackIndex& getBLStackIndex(pGModel model, pMesh pm);
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "pcBypass.h"
+#include "pcClassification.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcMotionBuffer.h"
+#include "pcQuality.h"
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace pc {
+
+  /* coordinates and shortest adjacent edge length of every vertex at the
+     last full mover run */
+  struct motionAnchor {
+    motionAnchor(): epoch(-1), mesh(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    std::vector<apf::MeshEntity*> verts;
+    std::vector<double> x[3];
+    std::vector<double> h;
+  };
+
+  static motionAnchor& getMotionAnchor() {
+    static motionAnchor a;
+    return a;
+  }
+
+  static double shortestEdge(apf::Mesh* m, apf::MeshEntity* v) {
+    apf::Adjacent edges;
+    m->getAdjacent(v, 1, edges);
+    apf::Vector3 p, q;
+    m->getPoint(v, 0, p);
+    double h = DBL_MAX;
+    apf::MeshEntity* ev[2];
+    for (size_t i = 0; i < edges.getSize(); i++) {
+      m->getDownward(edges[i], 0, ev);
+      m->getPoint(ev[0] == v ? ev[1] : ev[0], 0, q);
+      double l = 0;
+      for (int d = 0; d < 3; d++)
+        l += (q[d] - p[d]) * (q[d] - p[d]);
+      h = std::min(h, sqrt(l));
+    }
+    return h;
+  }
+
+  void setMotionAnchor(apf::Mesh2* m) {
+    motionAnchor& a = getMotionAnchor();
+    a.epoch = getTopologyEpoch();
+    a.mesh = m;
+    a.verts.clear();
+    a.verts.reserve(m->count(0));
+    apf::MeshEntity* v;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (v = m->iterate(itr)) )
+      a.verts.push_back(v);
+    m->end(itr);
+    size_t n = a.verts.size();
+    for (int d = 0; d < 3; d++)
+      a.x[d].resize(n);
+    a.h.resize(n);
+    apf::Vector3 p;
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(a.verts[i], 0, p);
+      for (int d = 0; d < 3; d++)
+        a.x[d][i] = p[d];
+      a.h[i] = shortestEdge(m, a.verts[i]);
+    }
+  }
+
+  static void setCoordinates(apf::Mesh2* m, motionAnchor const& a,
+      std::vector<double> const* x) {
+    apf::Vector3 p;
+    for (size_t i = 0; i < a.verts.size(); i++) {
+      for (int d = 0; d < 3; d++)
+        p[d] = x[d][i];
+      m->setPoint(a.verts[i], 0, p);
+    }
+  }
+
+  bool bypassMeshMotion(ph::Input& in, apf::Mesh2* m) {
+    control const& c = getControl();
+    /* the boundary exchange has no interior targets to check, and
+       Simmetrix meshes are only moved through their mover */
+    if (c.bypassThreshold <= 0 || c.motionExchange == EXCHANGE_BOUNDARY ||
+        in.simmetrixMesh)
+      return false;
+    motionAnchor& a = getMotionAnchor();
+    /* the vertex count catches a topology change that was not marked */
+    if (a.mesh != m || a.epoch != getTopologyEpoch() ||
+        a.verts.size() != m->count(0))
+      setMotionAnchor(m);
+    apf::Field* f = m->findField("motion_coords");
+    assert(f);
+    motionBuffer& mb = getMotionBuffer();
+    mb.verts = a.verts;
+    gatherMotion(m, f, mb);
+    /* accumulated motion relative to the anchor, in local edge lengths */
+    double ratio = 0;
+    for (size_t i = 0; i < mb.size(); i++) {
+      double d2 = 0;
+      for (int d = 0; d < 3; d++) {
+        double u = mb.target[d][i] - a.x[d][i];
+        d2 += u*u;
+      }
+      ratio = std::max(ratio, sqrt(d2) / a.h[i]);
+    }
+    ratio = PCU_Max_Double(ratio);
+    PC_LOG(PC_LOG_INFO, "accumulated motion is %f of the local edge length\n", ratio);
+    bool bypass = false;
+    if (ratio < c.bypassThreshold) {
+      setCoordinates(m, a, mb.target);
+      qualityReport quality;
+      scanQuality(m, quality);
+      bypass = (quality.numInvalid == 0 && quality.minQuality >= c.bypassMinQuality);
+      PC_LOG(PC_LOG_INFO, "moved mesh min tet shape %f, %ld invalid\n",
+          quality.minQuality, quality.numInvalid);
+    }
+    if (bypass) {
+      PC_LOG(PC_LOG_INFO, "bypassing the mesh mover at step %d\n", in.timeStepNumber);
+      return true;
+    }
+    /* the mover and the rigid body totals start from the anchor */
+    setCoordinates(m, a, a.x);
+    return false;
+  }
+
+}
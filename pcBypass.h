@@ -0,0 +1,24 @@
+#ifndef PC_BYPASS_H
+#define PC_BYPASS_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <chef.h>
+
+namespace pc {
+
+  /* collective; when the motion accumulated since the last full mover run
+     stays below pcBypassThreshold local edge lengths, apply motion_coords
+     directly and return true if the moved mesh is still above the
+     pcBypassMinQuality shape bound. Otherwise restore the coordinates of
+     the last full run, so the mover sees the whole accumulated motion
+     (rigid body totals are not reset while bypassing), and return false.
+     Never bypasses on Simmetrix meshes */
+  bool bypassMeshMotion(ph::Input& in, apf::Mesh2* m);
+
+  /* record the current coordinates as the start of the motion history */
+  void setMotionAnchor(apf::Mesh2* m);
+
+}
+
+#endif
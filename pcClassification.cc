@@ -0,0 +1,282 @@
+#include "pcClassification.h"
+#include "pcBLStacks.h"
+#include "pcLog.h"
+#include <MeshSim.h>
+#include <apfMesh2.h>
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+namespace pc {
+
+  static long topologyEpoch = 0;
+
+  void markTopologyChanged() {
+    topologyEpoch++;
+  }
+
+  long getTopologyEpoch() {
+    return topologyEpoch;
+  }
+
+  /* mesh entity count and an order free hash of their vertices */
+  typedef std::pair<long, unsigned long> entitySignature;
+
+  static long reparamEpoch = -1;
+  static pMesh reparamMesh = 0;
+  static std::map<pGEntity, entitySignature> reparamSignatures;
+
+  static unsigned long mix(unsigned long long z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (unsigned long)(z ^ (z >> 31));
+  }
+
+  static unsigned long mixPointer(pVertex v) {
+    return mix((uintptr_t)v);
+  }
+
+  static void getModelEntities(pGModel model, int dim, std::vector<pGEntity>& ents) {
+    ents.clear();
+    if (dim == 3) {
+      pGRegion gr;
+      GRIter grIter = GM_regionIter(model);
+      while((gr = GRIter_next(grIter))) ents.push_back(gr);
+      GRIter_delete(grIter);
+    }
+    else if (dim == 2) {
+      pGFace gf;
+      GFIter gfIter = GM_faceIter(model);
+      while((gf = GFIter_next(gfIter))) ents.push_back(gf);
+      GFIter_delete(gfIter);
+    }
+    else if (dim == 1) {
+      pGEdge ge;
+      GEIter geIter = GM_edgeIter(model);
+      while((ge = GEIter_next(geIter))) ents.push_back(ge);
+      GEIter_delete(geIter);
+    }
+    else {
+      pGVertex gv;
+      GVIter gvIter = GM_vertexIter(model);
+      while((gv = GVIter_next(gvIter))) ents.push_back(gv);
+      GVIter_delete(gvIter);
+    }
+  }
+
+  static void signDiscreteEntities(pGModel model, pMesh pm,
+      std::map<pGEntity, entitySignature>& sigs) {
+    sigs.clear();
+    std::vector<pGEntity> ents;
+    getModelEntities(model, 2, ents);
+    for (size_t i = 0; i < ents.size(); i++) {
+      if (!GEN_isDiscreteEntity(ents[i])) continue;
+      entitySignature& s = sigs[ents[i]];
+      pFace meshFace;
+      FIter fIter = M_classifiedFaceIter(pm, ents[i], 0);
+      while((meshFace = FIter_next(fIter))){
+        unsigned long h = 0;
+        for (int j = 0; j < 3; j++)
+          h += mixPointer(F_vertex(meshFace, j));
+        s.first++;
+        s.second += mix(h);
+      }
+      FIter_delete(fIter);
+    }
+    getModelEntities(model, 1, ents);
+    for (size_t i = 0; i < ents.size(); i++) {
+      if (!GEN_isDiscreteEntity(ents[i])) continue;
+      entitySignature& s = sigs[ents[i]];
+      pEdge meshEdge;
+      EIter eIter = M_classifiedEdgeIter(pm, ents[i], 0);
+      while((meshEdge = EIter_next(eIter))){
+        unsigned long h = mixPointer(E_vertex(meshEdge, 0)) + mixPointer(E_vertex(meshEdge, 1));
+        s.first++;
+        s.second += mix(h);
+      }
+      EIter_delete(eIter);
+    }
+  }
+
+  bool discreteModelChanged(pGModel model, pMesh pm) {
+    if (reparamMesh == pm && reparamEpoch == topologyEpoch)
+      return false;
+    double t0 = PCU_Time();
+    std::map<pGEntity, entitySignature> sigs;
+    signDiscreteEntities(model, pm, sigs);
+    long changed = 0;
+    if (reparamMesh != pm)
+      changed = (long)sigs.size();
+    else
+      for (std::map<pGEntity, entitySignature>::iterator it = sigs.begin(); it != sigs.end(); ++it) {
+        std::map<pGEntity, entitySignature>::iterator old = reparamSignatures.find(it->first);
+        if (old == reparamSignatures.end() || old->second != it->second)
+          changed++;
+      }
+    reparamEpoch = topologyEpoch;
+    reparamMesh = pm;
+    reparamSignatures.swap(sigs);
+    double t1 = PCU_Time();
+    PC_LOG_TOTAL(PC_LOG_INFO, "discrete model entities with a changed mesh", changed);
+    PC_LOG(PC_LOG_DEBUG, "signed the discrete model mesh in %f seconds\n", t1 - t0);
+    return PCU_Or(changed > 0);
+  }
+
+  static void buildClassificationIndex(classificationIndex& idx,
+      pGModel model, pMesh pm, std::vector<int> const& rbTags) {
+    idx.model = model;
+    idx.mesh = pm;
+    idx.rbTags = rbTags;
+    idx.vertices.clear();
+    idx.vertices.reserve(M_numVertices(pm));
+    idx.stackBody.clear();
+    idx.hasStackBody = false;
+
+    std::vector<pGEntity> rbRegions(rbTags.size());
+    for (size_t i = 0; i < rbTags.size(); i++)
+      rbRegions[i] = GM_entityByTag(model, 3, rbTags[i]);
+
+    /* model pass: rigid body id and type of every model entity */
+    typedef std::map<pGEntity, modelEntityInfo*> EntityMap;
+    EntityMap entMap;
+    std::vector<pGEntity> ents;
+    for (int d = 3; d >= 0; d--) {
+      idx.entities[d].clear();
+      getModelEntities(model, d, ents);
+      idx.entities[d].resize(ents.size());
+      for (size_t i = 0; i < ents.size(); i++) {
+        modelEntityInfo& info = idx.entities[d][i];
+        info.ent = ents[i];
+        info.dim = d;
+        info.rigidBody = -1;
+        for (size_t id = 0; id < rbRegions.size(); id++) {
+          if (GEN_inClosure(rbRegions[id], ents[i])) {
+            info.rigidBody = (int)id;
+            break;
+          }
+        }
+        info.discrete = GEN_isDiscreteEntity(ents[i]);
+        entMap[ents[i]] = &info;
+      }
+    }
+
+    /* discrete regions move their whole closure, so record for every
+       lower dimensional entity which of them it bounds */
+    std::map<pGEntity, std::vector<modelEntityInfo*> > closureOf;
+    for (size_t i = 0; i < idx.entities[3].size(); i++) {
+      modelEntityInfo& r = idx.entities[3][i];
+      if (r.rigidBody >= 0 || !r.discrete) continue;
+      for (int d = 0; d < 3; d++)
+        for (size_t j = 0; j < idx.entities[d].size(); j++)
+          if (GEN_inClosure(r.ent, idx.entities[d][j].ent))
+            closureOf[idx.entities[d][j].ent].push_back(&r);
+    }
+
+    /* single mesh pass: bucket every vertex by its classification */
+    pVertex meshVertex;
+    VIter vIter = M_vertexIter(pm);
+    while((meshVertex = VIter_next(vIter))){
+      int lid = (int)idx.vertices.size();
+      idx.vertices.push_back(meshVertex);
+      pGEntity g = EN_whatIn(meshVertex);
+      EntityMap::iterator it = entMap.find(g);
+      assert(it != entMap.end());
+      it->second->verts.push_back(lid);
+      if (it->second->dim == 3) continue;
+      std::map<pGEntity, std::vector<modelEntityInfo*> >::iterator cit = closureOf.find(g);
+      if (cit == closureOf.end()) continue;
+      for (size_t i = 0; i < cit->second.size(); i++)
+        cit->second[i]->verts.push_back(lid);
+    }
+    VIter_delete(vIter);
+    idx.epoch = topologyEpoch;
+  }
+
+  classificationIndex& getClassificationIndex(pGModel model, pMesh pm,
+      std::vector<int> const& rbTags) {
+    static classificationIndex idx;
+    if (idx.epoch != topologyEpoch ||
+        idx.mesh != pm ||
+        idx.rbTags != rbTags ||
+        (int)idx.vertices.size() != M_numVertices(pm)) {
+      double t0 = PCU_Time();
+      buildClassificationIndex(idx, model, pm, rbTags);
+      double t1 = PCU_Time();
+      PC_LOG(PC_LOG_INFO, "built model classification index in %f seconds\n", t1 - t0);
+    }
+    return idx;
+  }
+
+  /* a stack seen by one part tags the copies of its shared vertices on
+     the others, which may not see it */
+  static void reduceStackBodies(apf::Mesh* m, classificationIndex& idx,
+      std::unordered_map<pVertex, int> const& lid) {
+    apf::Copies remotes;
+    PCU_Comm_Begin();
+    for (size_t i = 0; i < idx.vertices.size(); i++) {
+      apf::MeshEntity* v = reinterpret_cast<apf::MeshEntity*>(idx.vertices[i]);
+      if (idx.stackBody[i] < 0 || !m->isShared(v))
+        continue;
+      remotes.clear();
+      m->getRemotes(v, remotes);
+      APF_ITERATE(apf::Copies, remotes, rit) {
+        PCU_COMM_PACK(rit->first, rit->second);
+        PCU_COMM_PACK(rit->first, idx.stackBody[i]);
+      }
+    }
+    PCU_Comm_Send();
+    while (PCU_Comm_Receive()) {
+      apf::MeshEntity* v;
+      int body;
+      PCU_COMM_UNPACK(v);
+      PCU_COMM_UNPACK(body);
+      std::unordered_map<pVertex, int>::const_iterator it =
+        lid.find(reinterpret_cast<pVertex>(v));
+      assert(it != lid.end());
+      idx.stackBody[it->second] = std::max(idx.stackBody[it->second], body);
+    }
+  }
+
+  std::vector<int> const& getRigidStackBodies(apf::Mesh* m,
+      classificationIndex& idx) {
+    if (idx.hasStackBody)
+      return idx.stackBody;
+    double t0 = PCU_Time();
+    idx.stackBody.assign(idx.vertices.size(), -1);
+    std::unordered_map<pVertex, int> lid;
+    for (size_t i = 0; i < idx.vertices.size(); i++)
+      lid[idx.vertices[i]] = (int)i;
+    std::unordered_map<pGEntity, int> bodyOf;
+    for (size_t i = 0; i < idx.entities[2].size(); i++)
+      if (idx.entities[2][i].rigidBody >= 0)
+        bodyOf[idx.entities[2][i].ent] = idx.entities[2][i].rigidBody;
+    long numStacks = 0;
+    blStackIndex& stacks = getBLStackIndex(idx.model, idx.mesh);
+    for (size_t s = 0; s < stacks.size(); s++) {
+      std::unordered_map<pGEntity, int>::iterator bit = bodyOf.find((pGEntity)stacks.modelFace[s]);
+      if (bit == bodyOf.end()) continue;
+      /* the base and any vertex on a wall keep their own motion */
+      for (int f = stacks.faceStart[s]; f < stacks.faceStart[s+1]; f++) {
+        for (int j = 0; j < 3; j++) {
+          pVertex v = F_vertex(stacks.faces[f], j);
+          if (EN_whatInType(v) != 3) continue;
+          std::unordered_map<pVertex, int>::iterator it = lid.find(v);
+          assert(it != lid.end());
+          idx.stackBody[it->second] = bit->second;
+        }
+      }
+      numStacks++;
+    }
+    reduceStackBodies(m, idx, lid);
+    idx.hasStackBody = true;
+    double t1 = PCU_Time();
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "rigid body boundary layer stacks", numStacks);
+    PC_LOG(PC_LOG_INFO, "found rigid body boundary layer stacks in %f seconds\n", t1 - t0);
+    return idx.stackBody;
+  }
+
+}
@@ -0,0 +1,64 @@
+#ifndef PC_CLASSIFICATION_H
+#define PC_CLASSIFICATION_H
+
+#include <SimPartitionedMesh.h>
+#include <apf.h>
+#include "SimModel.h"
+#include <vector>
+
+namespace pc {
+
+  /* one model entity and the mesh vertices the mover assigns to it */
+  struct modelEntityInfo {
+    pGEntity ent;
+    int dim;
+    int rigidBody; // index into the rigid body list, -1 if not on one
+    bool discrete;
+    /* local vertex ids (see classificationIndex::vertices);
+       discrete regions hold their whole closure, everything else
+       holds only the vertices classified on the entity itself */
+    std::vector<int> verts;
+  };
+
+  /* model entity -> rigid body id and vertex lists, built once per
+     topology epoch and reused by every mover setup of that epoch */
+  struct classificationIndex {
+    classificationIndex() : epoch(-1), model(0), mesh(0), hasStackBody(false) {}
+    long epoch;
+    pGModel model;
+    pMesh mesh;
+    std::vector<int> rbTags;
+    std::vector<pVertex> vertices;
+    std::vector<modelEntityInfo> entities[4];
+    /* per vertex, the rigid body whose boundary layer stacks hold it or
+       -1; set by getRigidStackBodies */
+    std::vector<int> stackBody;
+    bool hasStackBody;
+  };
+
+  /* call whenever adapt, improve or migration changes the mesh */
+  void markTopologyChanged();
+
+  long getTopologyEpoch();
+
+  /* returns the cached index, rebuilding it if the topology epoch,
+     the mesh or the set of rigid bodies changed */
+  classificationIndex& getClassificationIndex(pGModel model, pMesh pm,
+      std::vector<int> const& rbTags);
+
+  /* collective; false if no mesh face or edge classified on a discrete
+     model face or edge changed on any part since the last call that
+     returned true, so MS_reparameterizeForDiscrete can be skipped. Only
+     adapt, improve and migration change them, and they all mark the
+     topology changed; within an epoch no mesh pass is done */
+  bool discreteModelChanged(pGModel model, pMesh pm);
+
+  /* collective on first use within an epoch; interior vertices of the
+     boundary layer stacks based on the model faces of each rigid body,
+     from the stacks of getBLStackIndex. The copies of a shared vertex
+     agree on the largest body found on any part */
+  std::vector<int> const& getRigidStackBodies(apf::Mesh* m,
+      classificationIndex& idx);
+}
+
+#endif
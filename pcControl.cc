@@ -0,0 +1,184 @@
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcThreads.h"
+#include "pcTimeDepMesh.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace pc {
+
+  control::control() {
+    logLevel = PC_LOG_INFO;
+    numThreads = 1;
+    verifyLevel = VERIFY_FULL;
+    verifyEvery = 1;
+    checkpointEvery = 1;
+    checkpointInterval = 0;
+    checkpointInFlight = 2;
+    bypassThreshold = 0;
+    bypassMinQuality = 0.1;
+    writeMotionVtk = 1;
+    meshMover = MOVER_COPY;
+    elasticTolerance = 1e-6;
+    elasticMaxIterations = 1000;
+    rbfSupport = 0.5;
+    rbfTolerance = 1e-3;
+    rbfMaxCenters = 2000;
+    rbfFixedStride = 4;
+    gapReport = 0;
+    gapStop = 0;
+    maxSubsteps = 8;
+    substepSafety = 0.5;
+    untangle = 0;
+    untangleQuality = 0.02;
+    untangleLayers = 1;
+    untangleSweeps = 20;
+    blRigidMotion = 0;
+    blGapFraction = 0;
+    blKeepFraction = 0.5;
+    rigidFastPath = 0;
+    rigidTolerance = 1e-10;
+    paramWarmStart = 0;
+    influenceRadius = 0;
+    motionExchange = EXCHANGE_FULL;
+    sizeStages = "bound,budget,cfl,bound,gradation";
+    adaptOnInvalid = 0;
+  }
+
+  control& getControl() {
+    static control c;
+    return c;
+  }
+
+  int parseVerifyLevel(std::string const& name) {
+    if (name == "off" || name == "0") return VERIFY_OFF;
+    if (name == "sampled" || name == "1") return VERIFY_SAMPLED;
+    if (name == "cheap" || name == "2") return VERIFY_CHEAP;
+    if (name == "full" || name == "3") return VERIFY_FULL;
+    PC_LOG(PC_LOG_ERROR, "unknown pcVerifyLevel \"%s\"\n", name.c_str());
+    abort();
+    return VERIFY_FULL;
+  }
+
+  int parseMeshMover(std::string const& name) {
+    if (name == "copy") return MOVER_COPY;
+    if (name == "elastic") return MOVER_ELASTIC;
+    if (name == "rbf") return MOVER_RBF;
+    PC_LOG(PC_LOG_ERROR, "unknown pcMeshMover \"%s\"\n", name.c_str());
+    abort();
+    return MOVER_COPY;
+  }
+
+  int parseMotionExchange(std::string const& name) {
+    if (name == "full") return EXCHANGE_FULL;
+    if (name == "boundary") return EXCHANGE_BOUNDARY;
+    PC_LOG(PC_LOG_ERROR, "unknown pcMotionExchange \"%s\"\n", name.c_str());
+    abort();
+    return EXCHANGE_FULL;
+  }
+
+  void loadControl(const char* filename) {
+    control& c = getControl();
+    std::ifstream f(filename);
+    if (f) {
+      std::string line;
+      while (std::getline(f, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+          line.erase(comment);
+        std::istringstream ss(line);
+        std::string key, value;
+        if (!(ss >> key >> value))
+          continue;
+        if (key == "pcLogLevel")
+          c.logLevel = atoi(value.c_str());
+        else if (key == "pcNumThreads")
+          c.numThreads = atoi(value.c_str());
+        else if (key == "pcVerifyLevel")
+          c.verifyLevel = parseVerifyLevel(value);
+        else if (key == "pcVerifyEvery")
+          c.verifyEvery = atoi(value.c_str());
+        else if (key == "pcCheckpointEvery")
+          c.checkpointEvery = atoi(value.c_str());
+        else if (key == "pcCheckpointInterval")
+          c.checkpointInterval = atof(value.c_str());
+        else if (key == "pcCheckpointInFlight")
+          c.checkpointInFlight = atoi(value.c_str());
+        else if (key == "pcCheckpointStaging")
+          c.checkpointStaging = value;
+        else if (key == "pcBypassThreshold")
+          c.bypassThreshold = atof(value.c_str());
+        else if (key == "pcBypassMinQuality")
+          c.bypassMinQuality = atof(value.c_str());
+        else if (key == "pcMotionSchedule")
+          c.motionSchedule = value;
+        else if (key == "pcWriteMotionVtk")
+          c.writeMotionVtk = atoi(value.c_str());
+        else if (key == "pcMeshMover")
+          c.meshMover = parseMeshMover(value);
+        else if (key == "pcElasticTolerance")
+          c.elasticTolerance = atof(value.c_str());
+        else if (key == "pcElasticMaxIterations")
+          c.elasticMaxIterations = atoi(value.c_str());
+        else if (key == "pcRbfSupport")
+          c.rbfSupport = atof(value.c_str());
+        else if (key == "pcRbfTolerance")
+          c.rbfTolerance = atof(value.c_str());
+        else if (key == "pcRbfMaxCenters")
+          c.rbfMaxCenters = atoi(value.c_str());
+        else if (key == "pcRbfFixedStride")
+          c.rbfFixedStride = atoi(value.c_str());
+        else if (key == "pcGapReport")
+          c.gapReport = atoi(value.c_str());
+        else if (key == "pcGapStop")
+          c.gapStop = atof(value.c_str());
+        else if (key == "pcMaxSubsteps")
+          c.maxSubsteps = atoi(value.c_str());
+        else if (key == "pcSubstepSafety")
+          c.substepSafety = atof(value.c_str());
+        else if (key == "pcUntangle")
+          c.untangle = atoi(value.c_str());
+        else if (key == "pcUntangleQuality")
+          c.untangleQuality = atof(value.c_str());
+        else if (key == "pcUntangleLayers")
+          c.untangleLayers = atoi(value.c_str());
+        else if (key == "pcUntangleSweeps")
+          c.untangleSweeps = atoi(value.c_str());
+        else if (key == "pcBLRigidMotion")
+          c.blRigidMotion = atoi(value.c_str());
+        else if (key == "pcBLGapFraction")
+          c.blGapFraction = atof(value.c_str());
+        else if (key == "pcBLKeepFraction")
+          c.blKeepFraction = atof(value.c_str());
+        else if (key == "pcRigidFastPath")
+          c.rigidFastPath = atoi(value.c_str());
+        else if (key == "pcRigidTolerance")
+          c.rigidTolerance = atof(value.c_str());
+        else if (key == "pcParamWarmStart")
+          c.paramWarmStart = atoi(value.c_str());
+        else if (key == "pcInfluenceRadius")
+          c.influenceRadius = atof(value.c_str());
+        else if (key == "pcMotionExchange")
+          c.motionExchange = parseMotionExchange(value);
+        else if (key == "pcSizeStages")
+          c.sizeStages = value;
+        else if (key == "pcAdaptOnInvalid")
+          c.adaptOnInvalid = atoi(value.c_str());
+      }
+    }
+    else
+      PC_LOG(PC_LOG_WARN, "could not open %s, using default pc:: settings\n", filename);
+    if (c.verifyEvery < 1)
+      c.verifyEvery = 1;
+    if (c.checkpointInFlight < 1)
+      c.checkpointInFlight = 1;
+    setLogLevel(c.logLevel);
+    setNumThreads(c.numThreads);
+    if (!c.motionSchedule.empty())
+      loadMotionSchedule(c.motionSchedule.c_str(), getMotionSchedule());
+    PC_LOG(PC_LOG_INFO, "pc:: log level %d, %d threads, verify level %d every %d steps\n",
+        c.logLevel, getNumThreads(), c.verifyLevel, c.verifyEvery);
+  }
+
+}
@@ -0,0 +1,86 @@
+#ifndef PC_CONTROL_H
+#define PC_CONTROL_H
+
+#include <string>
+
+namespace pc {
+
+  /* mesh verification policy */
+  enum {
+    VERIFY_OFF,     // never verify
+    VERIFY_SAMPLED, // full verification every verifyEvery steps
+    VERIFY_CHEAP,   // boundary invariants, full only on the first call
+    VERIFY_FULL     // full verification at every call
+  };
+
+  /* mesh mover of non-Simmetrix meshes */
+  enum {
+    MOVER_COPY,    // copy motion_coords into the coordinates
+    MOVER_ELASTIC, // native pseudo-elastic solve for the interior
+    MOVER_RBF      // radial basis interpolation of the boundary motion
+  };
+
+  /* what the solver hands over for the mesh motion */
+  enum {
+    EXCHANGE_FULL,    // motion_coords of every vertex
+    EXCHANGE_BOUNDARY // rigid body transforms and motion_delta on the model boundary
+  };
+
+  /* pc:: settings read from the chef input file; every key is optional
+     and keys other than the pc ones below are ignored */
+  struct control {
+    control();
+    int logLevel;      // pcLogLevel
+    int numThreads;    // pcNumThreads
+    int verifyLevel;   // pcVerifyLevel: off, sampled, cheap or full
+    int verifyEvery;   // pcVerifyEvery: sampling period in steps
+    int checkpointEvery;       // pcCheckpointEvery: cycles between checkpoints, 0 for none
+    double checkpointInterval; // pcCheckpointInterval: seconds between checkpoints, 0 for none
+    int checkpointInFlight;    // pcCheckpointInFlight: staged checkpoints not yet moved
+    std::string checkpointStaging; // pcCheckpointStaging: staging directory, empty to write in place
+    double bypassThreshold;  // pcBypassThreshold: motion in edge lengths below which the mover is bypassed, 0 for never
+    double bypassMinQuality; // pcBypassMinQuality: tet shape bound of a bypassed step
+    std::string motionSchedule; // pcMotionSchedule: rigid body motion schedule file
+    int writeMotionVtk; // pcWriteMotionVtk: vtk dump after each APF coordinate update
+    int meshMover;      // pcMeshMover: copy, elastic or rbf
+    double elasticTolerance;  // pcElasticTolerance: relative CG residual
+    int elasticMaxIterations; // pcElasticMaxIterations
+    double rbfSupport;  // pcRbfSupport: support radius over the boundary bounding box diagonal
+    double rbfTolerance; // pcRbfTolerance: greedy selection error over the largest motion
+    int rbfMaxCenters;  // pcRbfMaxCenters
+    int rbfFixedStride; // pcRbfFixedStride: one in this many boundary points that stay is sent to the selection
+    int gapReport;      // pcGapReport: print the rigid body gaps every step
+    double gapStop;     // pcGapStop: gap below which the loop stops, 0 for never
+    int maxSubsteps;    // pcMaxSubsteps: mover substeps of an inverting motion, 1 to not predict
+    double substepSafety; // pcSubstepSafety: substep over the predicted inverting fraction
+    int untangle;       // pcUntangle: repair invalid apf meshes after the mover
+    double untangleQuality; // pcUntangleQuality: tet shape below which an element is repaired
+    int untangleLayers; // pcUntangleLayers: vertex rings added around the bad elements
+    int untangleSweeps; // pcUntangleSweeps
+    int blRigidMotion;  // pcBLRigidMotion: boundary layer stacks on rigid bodies move with them
+    double blGapFraction; // pcBLGapFraction: stack thickness over the nearest gap, 0 to never compress
+    double blKeepFraction; // pcBLKeepFraction: part of that thickness the inner layers keep
+    int rigidFastPath;  // pcRigidFastPath: move purely rigid steps without the mover
+    double rigidTolerance; // pcRigidTolerance: rigid motion error over the mesh extent
+    int paramWarmStart; // pcParamWarmStart: project surface moves from the cached parameters
+    double influenceRadius; // pcInfluenceRadius: distance from the bodies beyond which vertices stay, 0 for none
+    int motionExchange; // pcMotionExchange: full or boundary
+    std::string sizeStages; // pcSizeStages: comma separated size field stages, in order
+    int adaptOnInvalid; // pcAdaptOnInvalid: adapt only when the moved mesh has invalid elements
+  };
+
+  control& getControl();
+
+  /* every rank reads the file, then applies logLevel and numThreads
+     and loads the motion schedule */
+  void loadControl(const char* filename);
+
+  int parseVerifyLevel(std::string const& name);
+
+  int parseMeshMover(std::string const& name);
+
+  int parseMotionExchange(std::string const& name);
+
+}
+
+#endif
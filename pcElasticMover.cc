@@ -0,0 +1,282 @@
+#include "pcElasticMover.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcProximity.h"
+#include "pcRigidTransform.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace pc {
+
+  /* gradients of the four P1 basis functions of every tet, zero for
+     degenerate tets so they add no stiffness */
+  static void computeGradients(moverSystem const& s, motionBuffer const& mb,
+      std::vector<double>& grad) {
+    size_t ntet = s.tets.size() / 4;
+    grad.resize(12 * ntet);
+    parallelFor(ntet, [&](size_t b, size_t e, int) {
+      for (size_t t = b; t < e; t++) {
+        const int* v = &s.tets[4*t];
+        double J[3][3];
+        for (int r = 0; r < 3; r++)
+          for (int d = 0; d < 3; d++)
+            J[r][d] = mb.x[d][v[r+1]] - mb.x[d][v[0]];
+        double det = J[0][0]*(J[1][1]*J[2][2] - J[1][2]*J[2][1])
+                   - J[0][1]*(J[1][0]*J[2][2] - J[1][2]*J[2][0])
+                   + J[0][2]*(J[1][0]*J[2][1] - J[1][1]*J[2][0]);
+        double* g = &grad[12*t];
+        if (fabs(det) < 1e-300) {
+          for (int k = 0; k < 12; k++)
+            g[k] = 0;
+          continue;
+        }
+        /* rows of J^-T are the gradients of basis 1..3 */
+        double inv[3][3];
+        inv[0][0] = (J[1][1]*J[2][2] - J[1][2]*J[2][1]) / det;
+        inv[0][1] = (J[0][2]*J[2][1] - J[0][1]*J[2][2]) / det;
+        inv[0][2] = (J[0][1]*J[1][2] - J[0][2]*J[1][1]) / det;
+        inv[1][0] = (J[1][2]*J[2][0] - J[1][0]*J[2][2]) / det;
+        inv[1][1] = (J[0][0]*J[2][2] - J[0][2]*J[2][0]) / det;
+        inv[1][2] = (J[0][2]*J[1][0] - J[0][0]*J[1][2]) / det;
+        inv[2][0] = (J[1][0]*J[2][1] - J[1][1]*J[2][0]) / det;
+        inv[2][1] = (J[0][1]*J[2][0] - J[0][0]*J[2][1]) / det;
+        inv[2][2] = (J[0][0]*J[1][1] - J[0][1]*J[1][0]) / det;
+        for (int a = 0; a < 3; a++)
+          for (int d = 0; d < 3; d++)
+            g[3*(a+1) + d] = inv[d][a];
+        for (int d = 0; d < 3; d++)
+          g[d] = -(g[3+d] + g[6+d] + g[9+d]);
+      }
+    });
+  }
+
+  /* Lame parameters of the pseudo-material, E = 1 and nu = 0.3 */
+  static const double elasticLambda = 0.3 / (1.3 * 0.4);
+  static const double elasticMu = 1.0 / 2.6;
+
+  /* greedy coloring of the tets so no two of one color share a vertex;
+     colorTets[colorStart[c]] .. are the tets of color c */
+  static void colorTets(moverSystem const& s, std::vector<int>& colorStart,
+      std::vector<int>& colorTets) {
+    size_t n = s.verts.size();
+    size_t ntet = s.tets.size() / 4;
+    std::vector<int> degree(n, 0);
+    for (size_t i = 0; i < s.tets.size(); i++)
+      degree[s.tets[i]]++;
+    int maxDegree = n ? *std::max_element(degree.begin(), degree.end()) : 0;
+    /* a tet meets at most 4 (maxDegree - 1) others */
+    size_t words = (4 * (size_t)maxDegree + 64) / 64;
+    std::vector<uint64_t> used(n * words, 0);
+    std::vector<int> color(ntet);
+    int numColors = 0;
+    for (size_t t = 0; t < ntet; t++) {
+      const int* v = &s.tets[4*t];
+      int c = 0;
+      for (size_t w = 0; w < words; w++) {
+        uint64_t taken = 0;
+        for (int a = 0; a < 4; a++)
+          taken |= used[v[a]*words + w];
+        if (~taken) {
+          c = (int)(64*w);
+          while (taken & ((uint64_t)1 << (c%64)))
+            c++;
+          break;
+        }
+      }
+      for (int a = 0; a < 4; a++)
+        used[v[a]*words + c/64] |= (uint64_t)1 << (c%64);
+      color[t] = c;
+      numColors = std::max(numColors, c + 1);
+    }
+    colorStart.assign(numColors + 1, 0);
+    for (size_t t = 0; t < ntet; t++)
+      colorStart[color[t] + 1]++;
+    for (int c = 0; c < numColors; c++)
+      colorStart[c+1] += colorStart[c];
+    std::vector<int> at(colorStart.begin(), colorStart.end() - 1);
+    colorTets.resize(ntet);
+    for (size_t t = 0; t < ntet; t++)
+      colorTets[at[color[t]]++] = (int)t;
+  }
+
+  /* y = Ku with K the assembled stiffness; with the 1/V scaling the
+     element matrices are B^T D B without the volume factor. The tets of
+     one color are assembled in parallel straight into y */
+  struct elasticOperator {
+    moverSystem const& s;
+    std::vector<double> const& grad;
+    std::vector<int> colorStart;
+    std::vector<int> tets;
+    elasticOperator(moverSystem const& s_, std::vector<double> const& g):
+      s(s_), grad(g) {
+      colorTets(s, colorStart, tets);
+      PC_LOG(PC_LOG_DEBUG, "elastic operator: %d tet colors\n", (int)colorStart.size() - 1);
+    }
+    void apply(std::vector<double> const& u, std::vector<double>& y) {
+      size_t n = s.verts.size();
+      y.assign(3*n, 0.0);
+      for (size_t c = 0; c + 1 < colorStart.size(); c++) {
+        const int* ct = &tets[colorStart[c]];
+        parallelFor(colorStart[c+1] - colorStart[c], [&](size_t b, size_t e, int) {
+        for (size_t j = b; j < e; j++) {
+          size_t t = ct[j];
+          const int* v = &s.tets[4*t];
+          const double* g = &grad[12*t];
+          double G[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+          for (int a = 0; a < 4; a++)
+            for (int i = 0; i < 3; i++)
+              for (int k = 0; k < 3; k++)
+                G[i][k] += u[3*v[a]+i] * g[3*a+k];
+          double tr = G[0][0] + G[1][1] + G[2][2];
+          double S[3][3];
+          for (int i = 0; i < 3; i++)
+            for (int k = 0; k < 3; k++)
+              S[i][k] = elasticMu * (G[i][k] + G[k][i]) + ((i == k) ? elasticLambda * tr : 0.0);
+          for (int a = 0; a < 4; a++)
+            for (int i = 0; i < 3; i++)
+              y[3*v[a]+i] += S[i][0]*g[3*a] + S[i][1]*g[3*a+1] + S[i][2]*g[3*a+2];
+        }
+        });
+      }
+      accumulateShared(s, &y[0], 3);
+    }
+    void diagonal(std::vector<double>& d) {
+      size_t n = s.verts.size();
+      size_t ntet = s.tets.size() / 4;
+      d.assign(3*n, 0.0);
+      for (size_t t = 0; t < ntet; t++) {
+        const int* v = &s.tets[4*t];
+        const double* g = &grad[12*t];
+        for (int a = 0; a < 4; a++) {
+          double g2 = g[3*a]*g[3*a] + g[3*a+1]*g[3*a+1] + g[3*a+2]*g[3*a+2];
+          for (int i = 0; i < 3; i++)
+            d[3*v[a]+i] += elasticMu * g2 + (elasticLambda + elasticMu) * g[3*a+i] * g[3*a+i];
+        }
+      }
+      accumulateShared(s, &d[0], 3);
+    }
+  };
+
+  int solveElasticMotion(moverSystem const& s, motionBuffer& mb,
+      std::vector<char> const& fixed) {
+    control const& c = getControl();
+    size_t n = s.verts.size();
+    assert(mb.size() == n);
+    std::vector<double> grad;
+    computeGradients(s, mb, grad);
+    elasticOperator K(s, grad);
+    std::vector<double> u(3*n), r(3*n), z(3*n), p(3*n), q(3*n), d;
+    for (size_t i = 0; i < n; i++)
+      for (int k = 0; k < 3; k++)
+        u[3*i+k] = mb.disp[k][i];
+    K.diagonal(d);
+    /* the free rows of r = -Ku, fixed rows stay out of the Krylov space */
+    K.apply(u, q);
+    for (size_t i = 0; i < 3*n; i++)
+      r[i] = fixed[i/3] ? 0.0 : -q[i];
+    double r0 = sqrt(dotOwned(s, &r[0], &r[0], 3));
+    int it = 0;
+    if (r0 > 0) {
+      double rz = 0;
+      for (it = 1; it <= c.elasticMaxIterations; it++) {
+        for (size_t i = 0; i < 3*n; i++)
+          z[i] = (fixed[i/3] || d[i] <= 0) ? 0.0 : r[i] / d[i];
+        double rzNew = dotOwned(s, &r[0], &z[0], 3);
+        double beta = (it == 1) ? 0.0 : rzNew / rz;
+        rz = rzNew;
+        for (size_t i = 0; i < 3*n; i++)
+          p[i] = z[i] + beta * p[i];
+        K.apply(p, q);
+        for (size_t i = 0; i < 3*n; i++)
+          if (fixed[i/3]) q[i] = 0;
+        double pq = dotOwned(s, &p[0], &q[0], 3);
+        if (pq <= 0)
+          break;
+        double alpha = rz / pq;
+        for (size_t i = 0; i < 3*n; i++) {
+          u[i] += alpha * p[i];
+          r[i] -= alpha * q[i];
+        }
+        double rn = sqrt(dotOwned(s, &r[0], &r[0], 3));
+        PC_LOG(PC_LOG_TRACE, "elastic CG iteration %d residual %e\n", it, rn / r0);
+        if (rn <= c.elasticTolerance * r0)
+          break;
+      }
+      if (it > c.elasticMaxIterations)
+        PC_LOG(PC_LOG_WARN, "elastic mover did not converge in %d iterations\n",
+            c.elasticMaxIterations);
+    }
+    for (size_t i = 0; i < n; i++)
+      for (int k = 0; k < 3; k++) {
+        mb.disp[k][i] = u[3*i+k];
+        mb.target[k][i] = mb.x[k][i] + u[3*i+k];
+      }
+    return it;
+  }
+
+  bool gatherBoundaryMotion(ph::Input& in, apf::Mesh2* m, moverSystem const& s,
+      motionBuffer& mb) {
+    mb.verts = s.verts;
+    apf::Field* f = m->findField("motion_coords");
+    bool boundary = getControl().motionExchange == EXCHANGE_BOUNDARY;
+    if (f && !boundary) {
+      gatherMotion(m, f, mb);
+      return false;
+    }
+    gatherCoordinates(m, mb);
+    if (boundary) {
+      applyBoundaryDeltas(m, mb);
+      if (f)
+        apf::destroyField(f);
+    }
+    std::vector<rigidBodyMotion> rbms = getRigidBodyMotions(in);
+    transformRigidBodyTargets(m, rbms, s.index, mb);
+    computeDisplacements(mb);
+    return true;
+  }
+
+  void scatterCoordinates(apf::Mesh2* m, motionBuffer const& mb) {
+    apf::Field* coords = m->getCoordinateField();
+    double vals[3];
+    for (size_t i = 0; i < mb.size(); i++) {
+      for (int d = 0; d < 3; d++)
+        vals[d] = mb.target[d][i];
+      apf::setComponents(coords, mb.verts[i], 0, vals);
+    }
+  }
+
+  bool runElasticMover(ph::Input& in, apf::Mesh2* m) {
+    double t0 = PCU_Time();
+    moverSystem& s = getMoverSystem(m);
+    motionBuffer& mb = getMotionBuffer();
+    bool rigid = gatherBoundaryMotion(in, m, s, mb);
+    /* interior motion_coords, if any, only seed the solve */
+    if (rigid)
+      for (size_t i = 0; i < mb.size(); i++)
+        if (!s.boundary[i])
+          for (int d = 0; d < 3; d++)
+            mb.disp[d][i] = 0;
+    /* vertices beyond the influence radius are held in place */
+    std::vector<char> fixed = s.boundary;
+    std::vector<char> far;
+    findFarVertices(m, getRigidBodyMotions(in), mb, far);
+    for (size_t i = 0; i < far.size(); i++)
+      if (far[i] && !fixed[i]) {
+        fixed[i] = 1;
+        for (int d = 0; d < 3; d++)
+          mb.disp[d][i] = 0;
+      }
+    int its = solveElasticMotion(s, mb, fixed);
+    scatterCoordinates(m, mb);
+    if (rigid)
+      resetRigidBodyTotals(in);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "elastic mover: %d CG iterations in %f seconds\n", its, t1 - t0);
+    return true;
+  }
+
+}
@@ -0,0 +1,35 @@
+#ifndef PC_ELASTICMOVER_H
+#define PC_ELASTICMOVER_H
+
+#include "pcMoverSystem.h"
+#include "pcMotionBuffer.h"
+#include <chef.h>
+
+namespace pc {
+
+  /* collective; pseudo-elastic P1 tet stiffness with the element
+     stiffness scaled by 1/volume, so small elements near moving walls
+     deform least. mb.verts must be s.verts. On input mb.disp holds the
+     prescribed displacement of the fixed vertices and an initial guess
+     elsewhere, on output the solution. Matrix-free, threaded, Jacobi
+     preconditioned CG; returns the number of iterations */
+  int solveElasticMotion(moverSystem const& s, motionBuffer& mb,
+      std::vector<char> const& fixed);
+
+  /* collective; fill mb for s with the boundary motion: motion_coords if
+     attached and the exchange is full, otherwise the rigid body transforms
+     of phasta and, for the boundary exchange, the motion_delta of the
+     other boundary vertices (returns true in that case so the caller
+     resets the totals) */
+  bool gatherBoundaryMotion(ph::Input& in, apf::Mesh2* m, moverSystem const& s,
+      motionBuffer& mb);
+
+  /* write mb.target into the coordinates of every local vertex */
+  void scatterCoordinates(apf::Mesh2* m, motionBuffer const& mb);
+
+  /* native MDS mover: boundary motion as above, interior by elasticity */
+  bool runElasticMover(ph::Input& in, apf::Mesh2* m);
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "pcLog.h"
+#include <PCU.h>
+#include <cstdio>
+#include <cstdarg>
+
+namespace pc {
+
+  int logLevel = PC_LOG_INFO;
+
+  void setLogLevel(int level) {
+    logLevel = level;
+  }
+
+  static FILE* logStream(int level) {
+    return (level <= PC_LOG_WARN) ? stderr : stdout;
+  }
+
+  void logPrint(int level, const char* format, ...) {
+    if (PCU_Comm_Self())
+      return;
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(logStream(level), format, ap);
+    va_end(ap);
+  }
+
+  void logPrintAll(int level, const char* format, ...) {
+    FILE* f = logStream(level);
+    fprintf(f, "[%d] ", PCU_Comm_Self());
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(f, format, ap);
+    va_end(ap);
+  }
+
+  void logTotal(int level, const char* what, long count) {
+    long total = PCU_Add_Long(count);
+    if (!PCU_Comm_Self())
+      fprintf(logStream(level), "%s: %ld\n", what, total);
+  }
+
+}
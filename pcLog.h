@@ -0,0 +1,47 @@
+#ifndef PC_LOG_H
+#define PC_LOG_H
+
+/* verbosity levels of the pc:: log */
+#define PC_LOG_ERROR 0
+#define PC_LOG_WARN  1
+#define PC_LOG_INFO  2
+#define PC_LOG_DEBUG 3
+#define PC_LOG_TRACE 4
+
+/* messages above this level are compiled out, set it from cmake */
+#ifndef PC_LOG_MAX_LEVEL
+#define PC_LOG_MAX_LEVEL PC_LOG_INFO
+#endif
+
+namespace pc {
+
+  /* runtime verbosity, must be the same on every rank */
+  extern int logLevel;
+
+  void setLogLevel(int level);
+
+  /* printf style, printed by rank 0 only */
+  void logPrint(int level, const char* format, ...);
+
+  /* printf style, printed by every rank with a rank prefix */
+  void logPrintAll(int level, const char* format, ...);
+
+  /* collective: sum a per-rank counter and print the total on rank 0 */
+  void logTotal(int level, const char* what, long count);
+
+}
+
+#define PC_LOG_ON(level) \
+  ((level) <= PC_LOG_MAX_LEVEL && (level) <= pc::logLevel)
+
+/* the arguments are not evaluated when the level is disabled */
+#define PC_LOG(level, ...) \
+  do { if (PC_LOG_ON(level)) pc::logPrint(level, __VA_ARGS__); } while (0)
+
+#define PC_LOG_ALL(level, ...) \
+  do { if (PC_LOG_ON(level)) pc::logPrintAll(level, __VA_ARGS__); } while (0)
+
+#define PC_LOG_TOTAL(level, what, count) \
+  do { if (PC_LOG_ON(level)) pc::logTotal(level, what, count); } while (0)
+
+#endif
@@ -0,0 +1,85 @@
+#include "pcMotionBuffer.h"
+#include <cassert>
+
+namespace pc {
+
+  void collectVertices(apf::Mesh* m, motionBuffer& b) {
+    b.verts.clear();
+    b.verts.reserve(m->count(0));
+    apf::MeshEntity* vtx;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (vtx = m->iterate(itr)) )
+      b.verts.push_back(vtx);
+    m->end(itr);
+  }
+
+  void gatherMotion(apf::Mesh* m, apf::Field* motion, motionBuffer& b) {
+    assert(motion);
+    assert(apf::countComponents(motion) == 3);
+    size_t n = b.size();
+    for (int d = 0; d < 3; d++) {
+      b.x[d].resize(n);
+      b.target[d].resize(n);
+      b.disp[d].resize(n);
+    }
+    double vals[3];
+    apf::Vector3 p;
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(b.verts[i], 0, p);
+      apf::getComponents(motion, b.verts[i], 0, vals);
+      for (int d = 0; d < 3; d++) {
+        b.x[d][i] = p[d];
+        b.target[d][i] = vals[d];
+      }
+    }
+    computeDisplacements(b);
+  }
+
+  void computeDisplacements(motionBuffer& b) {
+    size_t n = b.size();
+    if (!n) return;
+    for (int d = 0; d < 3; d++) {
+      const double* x = &b.x[d][0];
+      const double* t = &b.target[d][0];
+      double* u = &b.disp[d][0];
+      for (size_t i = 0; i < n; i++)
+        u[i] = t[i] - x[i];
+    }
+  }
+
+  void gatherCoordinates(apf::Mesh* m, motionBuffer& b) {
+    size_t n = b.size();
+    for (int d = 0; d < 3; d++) {
+      b.x[d].resize(n);
+      b.target[d].resize(n);
+      b.disp[d].assign(n, 0.0);
+    }
+    apf::Vector3 p;
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(b.verts[i], 0, p);
+      for (int d = 0; d < 3; d++)
+        b.x[d][i] = b.target[d][i] = p[d];
+    }
+  }
+
+  void applyBoundaryDeltas(apf::Mesh* m, motionBuffer& b) {
+    apf::Field* delta = m->findField("motion_delta");
+    if (delta) {
+      assert(apf::countComponents(delta) == 3);
+      double vals[3];
+      for (size_t i = 0; i < b.size(); i++) {
+        if (m->getModelType(m->toModel(b.verts[i])) == 3)
+          continue;
+        apf::getComponents(delta, b.verts[i], 0, vals);
+        for (int d = 0; d < 3; d++)
+          b.target[d][i] += vals[d];
+      }
+    }
+  }
+
+  motionBuffer& getMotionBuffer() {
+    static motionBuffer b;
+    return b;
+  }
+
+}
@@ -0,0 +1,41 @@
+#ifndef PC_MOTIONBUFFER_H
+#define PC_MOTIONBUFFER_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <vector>
+
+namespace pc {
+
+  /* structure-of-arrays copy of the motion_coords field and the
+     current coordinates, indexed by local vertex id (position in verts) */
+  struct motionBuffer {
+    std::vector<apf::MeshEntity*> verts;
+    std::vector<double> x[3];      // current coordinates
+    std::vector<double> target[3]; // motion_coords
+    std::vector<double> disp[3];   // target - x
+    size_t size() const { return verts.size(); }
+  };
+
+  /* fill b.verts with the local vertices in iteration order */
+  void collectVertices(apf::Mesh* m, motionBuffer& b);
+
+  /* one pass over b.verts copying coordinates and motion_coords,
+     followed by computeDisplacements */
+  void gatherMotion(apf::Mesh* m, apf::Field* motion, motionBuffer& b);
+
+  void computeDisplacements(motionBuffer& b);
+
+  /* copy the coordinates of b.verts, with zero displacement */
+  void gatherCoordinates(apf::Mesh* m, motionBuffer& b);
+
+  /* boundary exchange: add the solver's motion_delta displacements, if
+     attached, to b.target of the vertices classified on the model
+     boundary. A motion_coords still attached is left to the caller */
+  void applyBoundaryDeltas(apf::Mesh* m, motionBuffer& b);
+
+  /* returns the buffer shared by the mover backends of this rank */
+  motionBuffer& getMotionBuffer();
+}
+
+#endif
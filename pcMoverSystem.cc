@@ -0,0 +1,150 @@
+#include "pcMoverSystem.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include "pcQuality.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+
+namespace pc {
+
+  /* both sides of a peer pair sort their shared copies by the address of
+     the copy on the lower rank, which each side knows from its remotes,
+     so the lists pair up without any communication */
+  static void buildPeers(apf::Mesh* m, moverSystem& s) {
+    typedef std::pair<size_t, int> Key;
+    std::map<int, std::vector<Key> > keyed;
+    int self = PCU_Comm_Self();
+    apf::Copies remotes;
+    for (size_t i = 0; i < s.verts.size(); i++) {
+      if (!m->isShared(s.verts[i]))
+        continue;
+      remotes.clear();
+      m->getRemotes(s.verts[i], remotes);
+      APF_ITERATE(apf::Copies, remotes, rit) {
+        apf::MeshEntity* key = (self < rit->first) ? s.verts[i] : rit->second;
+        keyed[rit->first].push_back(Key(reinterpret_cast<size_t>(key), (int)i));
+      }
+    }
+    s.peers.clear();
+    for (std::map<int, std::vector<Key> >::iterator it = keyed.begin();
+        it != keyed.end(); ++it) {
+      std::sort(it->second.begin(), it->second.end());
+      std::vector<int>& ids = s.peers[it->first];
+      ids.resize(it->second.size());
+      for (size_t k = 0; k < it->second.size(); k++)
+        ids[k] = it->second[k].second;
+    }
+  }
+
+  static void buildMoverSystem(apf::Mesh* m, moverSystem& s) {
+    s.epoch = getTopologyEpoch();
+    s.mesh = m;
+    s.verts.clear();
+    s.index.clear();
+    s.owned.clear();
+    s.boundary.clear();
+    s.tets.clear();
+    apf::MeshEntity* e;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (e = m->iterate(itr)) ) {
+      s.index[e] = (int)s.verts.size();
+      s.verts.push_back(e);
+      s.owned.push_back(m->isOwned(e));
+      s.boundary.push_back(m->getModelType(m->toModel(e)) < m->getDimension());
+    }
+    m->end(itr);
+    apf::Downward dv;
+    itr = m->begin(m->getDimension());
+    while( (e = m->iterate(itr)) ) {
+      const int (*split)[4];
+      int nt = getTetSplit(m->getType(e), &split);
+      m->getDownward(e, 0, dv);
+      for (int t = 0; t < nt; t++)
+        for (int k = 0; k < 4; k++)
+          s.tets.push_back(s.index[dv[split[t][k]]]);
+    }
+    m->end(itr);
+    buildPeers(m, s);
+  }
+
+  moverSystem& getMoverSystem(apf::Mesh* m) {
+    static moverSystem s;
+    if (s.epoch != getTopologyEpoch() || s.mesh != m) {
+      double t0 = PCU_Time();
+      buildMoverSystem(m, s);
+      double t1 = PCU_Time();
+      PC_LOG(PC_LOG_INFO, "built mover system in %f seconds\n", t1 - t0);
+    }
+    return s;
+  }
+
+  void accumulateShared(moverSystem const& s, double* v, int ncomp) {
+    typedef std::map<int, std::vector<int> >::const_iterator PeerIt;
+    PCU_Comm_Begin();
+    std::vector<double> buf;
+    for (PeerIt it = s.peers.begin(); it != s.peers.end(); ++it) {
+      std::vector<int> const& ids = it->second;
+      buf.resize(ids.size() * ncomp);
+      for (size_t k = 0; k < ids.size(); k++)
+        for (int c = 0; c < ncomp; c++)
+          buf[k*ncomp + c] = v[ids[k]*ncomp + c];
+      if (!buf.empty())
+        PCU_Comm_Pack(it->first, &buf[0], buf.size() * sizeof(double));
+    }
+    PCU_Comm_Send();
+    std::map<int, std::vector<double> > received;
+    while (PCU_Comm_Receive()) {
+      PeerIt it = s.peers.find(PCU_Comm_Sender());
+      assert(it != s.peers.end());
+      std::vector<double>& in = received[it->first];
+      in.resize(it->second.size() * ncomp);
+      PCU_Comm_Unpack(&in[0], in.size() * sizeof(double));
+    }
+    /* every copy of a shared vertex adds the values of its parts in rank
+       order, so all copies get the same bits */
+    std::vector<double> sum(v, v + s.verts.size() * ncomp);
+    std::vector<char> shared(s.verts.size(), 0);
+    for (PeerIt it = s.peers.begin(); it != s.peers.end(); ++it)
+      for (size_t k = 0; k < it->second.size(); k++)
+        shared[it->second[k]] = 1;
+    for (size_t i = 0; i < shared.size(); i++)
+      if (shared[i])
+        for (int c = 0; c < ncomp; c++)
+          sum[i*ncomp + c] = 0;
+    int self = PCU_Comm_Self();
+    bool addedSelf = false;
+    for (PeerIt it = s.peers.begin(); ; ++it) {
+      if (!addedSelf && (it == s.peers.end() || it->first > self)) {
+        for (size_t i = 0; i < shared.size(); i++)
+          if (shared[i])
+            for (int c = 0; c < ncomp; c++)
+              sum[i*ncomp + c] += v[i*ncomp + c];
+        addedSelf = true;
+      }
+      if (it == s.peers.end())
+        break;
+      std::vector<int> const& ids = it->second;
+      std::vector<double> const& in = received[it->first];
+      assert(in.size() == ids.size() * ncomp);
+      for (size_t k = 0; k < ids.size(); k++)
+        for (int c = 0; c < ncomp; c++)
+          sum[ids[k]*ncomp + c] += in[k*ncomp + c];
+    }
+    std::copy(sum.begin(), sum.end(), v);
+  }
+
+  double dotOwned(moverSystem const& s, const double* a, const double* b, int ncomp) {
+    double local = parallelSum(s.verts.size(), [&](size_t i) {
+      if (!s.owned[i])
+        return 0.0;
+      double d = 0;
+      for (int c = 0; c < ncomp; c++)
+        d += a[i*ncomp + c] * b[i*ncomp + c];
+      return d;
+    });
+    return PCU_Add_Double(local);
+  }
+
+}
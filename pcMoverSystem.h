@@ -0,0 +1,40 @@
+#ifndef PC_MOVERSYSTEM_H
+#define PC_MOVERSYSTEM_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace pc {
+
+  /* local vertices in a fixed order, element connectivity and part
+     boundary exchange lists of the native movers; built once per
+     topology epoch */
+  struct moverSystem {
+    moverSystem(): epoch(-1), mesh(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    std::vector<apf::MeshEntity*> verts;
+    std::unordered_map<apf::MeshEntity*, int> index;
+    std::vector<char> owned;
+    std::vector<char> boundary; // classified on a model entity of dim < 3
+    std::vector<int> tets;      // 4 vertex ids per tet, other types split
+    /* shared copies, in the same order on both sides of each peer pair */
+    std::map<int, std::vector<int> > peers;
+  };
+
+  moverSystem& getMoverSystem(apf::Mesh* m);
+
+  /* collective; sum the ncomp values per vertex over all copies of the
+     shared vertices in rank order, so every copy gets the same bits; v
+     is interleaved by vertex */
+  void accumulateShared(moverSystem const& s, double* v, int ncomp);
+
+  /* collective; sum over owned vertices of a.b, interleaved by vertex */
+  double dotOwned(moverSystem const& s, const double* a, const double* b, int ncomp);
+
+}
+
+#endif
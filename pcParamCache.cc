@@ -0,0 +1,158 @@
+#include "pcParamCache.h"
+#include "SimModel.h"
+#include "MeshSim.h"
+#include "SimMeshMove.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pc {
+
+  /* Gauss-Newton iterations before giving up on the warm start */
+  static const int maxSteps = 8;
+
+  paramCache& getParamCache(classificationIndex const& idx) {
+    static paramCache c;
+    size_t n = idx.vertices.size();
+    if (c.epoch != idx.epoch || c.mesh != idx.mesh || c.valid.size() != n) {
+      c.epoch = idx.epoch;
+      c.mesh = idx.mesh;
+      c.valid.assign(n, 0);
+      c.x.resize(3 * n);
+      c.par.resize(2 * n);
+      c.deriv.resize(6 * n);
+    }
+    return c;
+  }
+
+  static void evaluate(pGEntity g, int dim, const double* par, double* pt, double* deriv) {
+    if (dim == 2) {
+      GF_point((pGFace)g, par, pt);
+      GF_firstDerivative((pGFace)g, par, deriv, deriv + 3);
+    }
+    else {
+      GE_point((pGEdge)g, par[0], pt);
+      GE_firstDerivative((pGEdge)g, par[0], deriv);
+      std::fill(deriv + 3, deriv + 6, 0.0);
+    }
+  }
+
+  static bool inRange(pGEntity g, int dim, const double* par) {
+    double lo, hi;
+    for (int k = 0; k < dim; k++) {
+      if (dim == 2)
+        GF_parRange((pGFace)g, k, &lo, &hi);
+      else
+        GE_parRange((pGEdge)g, &lo, &hi);
+      if (par[k] < lo || par[k] > hi)
+        return false;
+    }
+    return true;
+  }
+
+  static void getVertexParams(pVertex v, int dim, double* par) {
+    pPoint p = V_point(v);
+    if (dim == 2) {
+      int flag;
+      P_param2(p, par, par + 1, &flag);
+    }
+    else {
+      par[0] = P_param1(p);
+      par[1] = 0;
+    }
+  }
+
+  static void store(paramCache& c, int lid, pGEntity g, int dim,
+      const double* par, const double* pt) {
+    double y[3];
+    std::copy(par, par + 2, &c.par[2*lid]);
+    std::copy(pt, pt + 3, &c.x[3*lid]);
+    evaluate(g, dim, par, y, &c.deriv[6*lid]);
+    c.valid[lid] = 1;
+  }
+
+  static bool isCurrent(paramCache const& c, int lid, const double* x) {
+    if (!c.valid[lid])
+      return false;
+    double d2 = 0, x2 = 0;
+    for (int d = 0; d < 3; d++) {
+      double e = x[d] - c.x[3*lid + d];
+      d2 += e*e;
+      x2 += x[d]*x[d];
+    }
+    return d2 <= 1e-24 * (1 + x2);
+  }
+
+  /* minimize |S(q) - t| from the start q, S(q) = y with derivatives D */
+  static bool gaussNewton(pGEntity g, int dim, const double* t, double* q,
+      double* y, double* D, double tol2) {
+    for (int it = 0; it < maxSteps; it++) {
+      double r[3] = {t[0] - y[0], t[1] - y[1], t[2] - y[2]};
+      double dq[2] = {0, 0};
+      double a = D[0]*D[0] + D[1]*D[1] + D[2]*D[2];
+      double g0 = D[0]*r[0] + D[1]*r[1] + D[2]*r[2];
+      if (dim == 2) {
+        double b = D[0]*D[3] + D[1]*D[4] + D[2]*D[5];
+        double cc = D[3]*D[3] + D[4]*D[4] + D[5]*D[5];
+        double g1 = D[3]*r[0] + D[4]*r[1] + D[5]*r[2];
+        double det = a*cc - b*b;
+        if (!(det > 1e-12 * a * cc))
+          return false;
+        dq[0] = (cc*g0 - b*g1) / det;
+        dq[1] = (a*g1 - b*g0) / det;
+      }
+      else {
+        if (!(a > 0))
+          return false;
+        dq[0] = g0 / a;
+      }
+      double s2 = 0;
+      for (int d = 0; d < 3; d++) {
+        double s = dq[0]*D[d] + dq[1]*D[3+d];
+        s2 += s*s;
+      }
+      q[0] += dq[0];
+      q[1] += dq[1];
+      if (!inRange(g, dim, q))
+        return false;
+      evaluate(g, dim, q, y, D);
+      if (s2 <= tol2)
+        return true;
+    }
+    return false;
+  }
+
+  bool movedParamPoint(paramCache& c, int lid, pVertex v, pGEntity g, int dim,
+      const double* x, const double* disp, double* par, double* pt) {
+    bool current = isCurrent(c, lid, x);
+    double m2 = disp[0]*disp[0] + disp[1]*disp[1] + disp[2]*disp[2];
+    if (m2 == 0) {
+      if (current)
+        std::copy(&c.par[2*lid], &c.par[2*lid] + 2, par);
+      else
+        getVertexParams(v, dim, par);
+      std::copy(x, x + 3, pt);
+      return true;
+    }
+    if (!current) {
+      getVertexParams(v, dim, par);
+      store(c, lid, g, dim, par, x);
+    }
+    double q[2] = {c.par[2*lid], c.par[2*lid + 1]};
+    double y[3] = {x[0], x[1], x[2]};
+    double D[6];
+    std::copy(&c.deriv[6*lid], &c.deriv[6*lid] + 6, D);
+    const double t[3] = {x[0] + disp[0], x[1] + disp[1], x[2] + disp[2]};
+    if (gaussNewton(g, dim, t, q, y, D, 1e-16 * m2)) {
+      std::copy(q, q + 2, par);
+      std::copy(y, y + 3, pt);
+      std::copy(q, q + 2, &c.par[2*lid]);
+      std::copy(y, y + 3, &c.x[3*lid]);
+      std::copy(D, D + 6, &c.deriv[6*lid]);
+      return true;
+    }
+    V_movedParamPoint(v, disp, par, pt);
+    store(c, lid, g, dim, par, pt);
+    return false;
+  }
+
+}
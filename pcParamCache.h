@@ -0,0 +1,37 @@
+#ifndef PC_PARAM_CACHE_H
+#define PC_PARAM_CACHE_H
+
+#include "pcClassification.h"
+#include <vector>
+
+namespace pc {
+
+  /* parameters and first derivatives of the vertices on parametric model
+     faces and edges, by local id of the classification index, as left by
+     the last mover setup of the topology epoch. An entry is only trusted
+     while the vertex is still at the point it was computed for */
+  struct paramCache {
+    paramCache(): epoch(-1), mesh(0) {}
+    long epoch;
+    pMesh mesh;
+    std::vector<char> valid;
+    std::vector<double> x;     // 3 per vertex
+    std::vector<double> par;   // 2 per vertex, edges use the first
+    std::vector<double> deriv; // 6 per vertex: d/du then d/dv, edges use the first 3
+  };
+
+  paramCache& getParamCache(classificationIndex const& idx);
+
+  /* the point of the face or edge g nearest to x + disp and its
+     parameters, the same as V_movedParamPoint, from a few Gauss-Newton
+     steps warm started at the cached parameters of vertex lid. A vertex
+     that does not move keeps its parameters. Falls back to
+     V_movedParamPoint when there is no usable start, a step leaves the
+     parameter range or the iteration does not converge; returns false
+     then */
+  bool movedParamPoint(paramCache& c, int lid, pVertex v, pGEntity g, int dim,
+      const double* x, const double* disp, double* par, double* pt);
+
+}
+
+#endif
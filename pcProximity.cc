@@ -0,0 +1,651 @@
+#include "pcProximity.h"
+#include "pcClassification.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcRigidTransform.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <gmi.h>
+#include <mpi.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+namespace pc {
+
+  struct gapCache {
+    gapCache(): epoch(-1), mesh(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    std::vector<int> tags;
+    std::vector<gapSurface> surfaces; // one per body in tags order, then the static faces
+    std::vector<rigidBodyMotion> last; // per body, the transforms of the last call
+    std::vector<std::vector<double> > local;   // per surface, the owned triangles last seen
+    std::vector<std::vector<double> > current; // per surface, all triangles at the current coordinates
+  };
+
+  /* index of the surface an entity belongs to: a body, tags.size() for
+     none, -1 for more than one body */
+  static int surfaceOf(gmi_model* g, gmi_ent* e, std::vector<gmi_ent*> const& bodies) {
+    int found = (int)bodies.size();
+    for (size_t i = 0; i < bodies.size(); i++) {
+      if (e != bodies[i] && !gmi_is_in_closure_of(g, e, bodies[i]))
+        continue;
+      if (found != (int)bodies.size())
+        return -1;
+      found = (int)i;
+    }
+    return found;
+  }
+
+  static void collectFaces(apf::Mesh* m, gapCache& c) {
+    gmi_model* g = m->getModel();
+    std::vector<gmi_ent*> bodies(c.tags.size());
+    for (size_t i = 0; i < c.tags.size(); i++) {
+      bodies[i] = gmi_find(g, 3, c.tags[i]);
+      assert(bodies[i]);
+    }
+    c.surfaces.assign(c.tags.size() + 1, gapSurface());
+    for (size_t i = 0; i < c.tags.size(); i++)
+      c.surfaces[i].tag = c.tags[i];
+    c.surfaces.back().tag = -1;
+    std::map<gmi_ent*, int> known;
+    apf::MeshEntity* f;
+    apf::MeshIterator* itr = m->begin(2);
+    while( (f = m->iterate(itr)) ) {
+      apf::ModelEntity* me = m->toModel(f);
+      if (m->getModelType(me) != 2 || !m->isOwned(f))
+        continue;
+      apf::Downward vs;
+      m->getDownward(f, 0, vs);
+      int s = -2;
+      for (int j = -1; j < 3; j++) {
+        gmi_ent* e = reinterpret_cast<gmi_ent*>(j < 0 ? me : m->toModel(vs[j]));
+        std::map<gmi_ent*, int>::iterator it = known.find(e);
+        if (it == known.end())
+          it = known.insert(std::make_pair(e, surfaceOf(g, e, bodies))).first;
+        /* every vertex must belong to the surface of the face only */
+        if (j < 0)
+          s = it->second;
+        else if (it->second != s)
+          s = -1;
+        if (s < 0)
+          break;
+      }
+      if (s >= 0)
+        c.surfaces[s].faces.push_back(f);
+    }
+    m->end(itr);
+  }
+
+  static void localTriangles(apf::Mesh* m, gapSurface const& s, std::vector<double>& local) {
+    local.resize(9 * s.faces.size());
+    apf::Vector3 p;
+    for (size_t i = 0; i < s.faces.size(); i++) {
+      apf::Downward vs;
+      m->getDownward(s.faces[i], 0, vs);
+      for (int j = 0; j < 3; j++) {
+        m->getPoint(vs[j], 0, p);
+        for (int d = 0; d < 3; d++)
+          local[9*i + 3*j + d] = p[d];
+      }
+    }
+  }
+
+  /* all the triangles of the surface from the local ones of every part */
+  static void gatherTriangles(gapSurface& s, std::vector<double> const& local,
+      std::vector<double>& all, bool first) {
+    MPI_Comm comm = PCU_Get_Comm();
+    int peers = PCU_Comm_Peers();
+    int count = (int)local.size();
+    if (first) {
+      s.counts.resize(peers);
+      MPI_Allgather(&count, 1, MPI_INT, &s.counts[0], 1, MPI_INT, comm);
+    }
+    std::vector<int> displs(peers + 1, 0);
+    for (int r = 0; r < peers; r++)
+      displs[r+1] = displs[r] + s.counts[r];
+    all.resize(displs[peers]);
+    MPI_Allgatherv(local.empty() ? 0 : &local[0], count, MPI_DOUBLE,
+        all.empty() ? 0 : &all[0], &s.counts[0], &displs[0], MPI_DOUBLE, comm);
+  }
+
+  /* tri holds 3 coordinates per point */
+  static void transformTriangles(rigidTransform const& T, std::vector<double>& tri) {
+    size_t n = tri.size() / 3;
+    if (!n)
+      return;
+    std::vector<double> x[3];
+    for (int d = 0; d < 3; d++) {
+      x[d].resize(n);
+      for (size_t i = 0; i < n; i++)
+        x[d][i] = tri[3*i + d];
+    }
+    double* const xp[3] = {&x[0][0], &x[1][0], &x[2][0]};
+    applyRigidTransform(T, n, xp, xp);
+    for (int d = 0; d < 3; d++)
+      for (size_t i = 0; i < n; i++)
+        tri[3*i + d] = x[d][i];
+  }
+
+  /* how the owned triangles changed since they were last seen */
+  enum {
+    SURFACE_SAME,  // not at all
+    SURFACE_MOVED, // by the transform of the body at the last call
+    SURFACE_OTHER  // otherwise, the surface is gathered again
+  };
+
+  static int surfaceChange(std::vector<double> const& before,
+      std::vector<double> const& now, rigidBodyMotion const* last) {
+    if (before == now)
+      return SURFACE_SAME;
+    if (!last || before.size() != now.size())
+      return SURFACE_OTHER;
+    std::vector<double> moved(before);
+    transformTriangles(makeRigidTransform(*last), moved);
+    double tol = getControl().rigidTolerance;
+    for (size_t i = 0; i < now.size(); i++)
+      if (fabs(moved[i] - now[i]) > tol * std::max(1.0, fabs(now[i])))
+        return SURFACE_OTHER;
+    return SURFACE_MOVED;
+  }
+
+  static void triangleBox(const double* t, double* lo, double* hi) {
+    for (int d = 0; d < 3; d++) {
+      lo[d] = std::min(t[d], std::min(t[3+d], t[6+d]));
+      hi[d] = std::max(t[d], std::max(t[3+d], t[6+d]));
+    }
+  }
+
+  static int buildNode(gapSurface& s, int first, int count) {
+    int id = (int)s.nodes.size();
+    s.nodes.push_back(bvhNode());
+    s.nodes[id].left = s.nodes[id].right = -1;
+    s.nodes[id].first = first;
+    s.nodes[id].count = count;
+    if (count <= 4)
+      return id;
+    /* median split along the longest extent of the centroids */
+    double lo[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for (int i = first; i < first + count; i++) {
+      const double* t = &s.tri[9 * s.order[i]];
+      for (int d = 0; d < 3; d++) {
+        double c = t[d] + t[3+d] + t[6+d];
+        lo[d] = std::min(lo[d], c);
+        hi[d] = std::max(hi[d], c);
+      }
+    }
+    int axis = 0;
+    for (int d = 1; d < 3; d++)
+      if (hi[d] - lo[d] > hi[axis] - lo[axis])
+        axis = d;
+    const double* tri = &s.tri[0];
+    int half = count / 2;
+    std::nth_element(s.order.begin() + first, s.order.begin() + first + half,
+        s.order.begin() + first + count, [tri, axis](int a, int b) {
+          return tri[9*a + axis] + tri[9*a + 3 + axis] + tri[9*a + 6 + axis] <
+                 tri[9*b + axis] + tri[9*b + 3 + axis] + tri[9*b + 6 + axis];
+        });
+    int left = buildNode(s, first, half);
+    int right = buildNode(s, first + half, count - half);
+    s.nodes[id].left = left;
+    s.nodes[id].right = right;
+    s.nodes[id].count = 0;
+    return id;
+  }
+
+  /* bottom up, children always follow their parent */
+  static void refit(gapSurface& s) {
+    for (size_t k = s.nodes.size(); k-- > 0; ) {
+      bvhNode& b = s.nodes[k];
+      if (b.left < 0) {
+        triangleBox(&s.tri[9 * s.order[b.first]], b.lo, b.hi);
+        double lo[3], hi[3];
+        for (int i = b.first + 1; i < b.first + b.count; i++) {
+          triangleBox(&s.tri[9 * s.order[i]], lo, hi);
+          for (int d = 0; d < 3; d++) {
+            b.lo[d] = std::min(b.lo[d], lo[d]);
+            b.hi[d] = std::max(b.hi[d], hi[d]);
+          }
+        }
+      }
+      else {
+        bvhNode const& l = s.nodes[b.left];
+        bvhNode const& r = s.nodes[b.right];
+        for (int d = 0; d < 3; d++) {
+          b.lo[d] = std::min(l.lo[d], r.lo[d]);
+          b.hi[d] = std::max(l.hi[d], r.hi[d]);
+        }
+      }
+    }
+  }
+
+  static void buildTree(gapSurface& s) {
+    s.nodes.clear();
+    s.order.resize(s.size());
+    for (size_t i = 0; i < s.order.size(); i++)
+      s.order[i] = (int)i;
+    if (s.size())
+      buildNode(s, 0, (int)s.size());
+  }
+
+  /* the triangles are gathered once per topology epoch; afterwards each
+     part compares its own triangles with those last seen and a single
+     reduction decides per surface whether the cached triangles stay,
+     follow the body transform of the last call, or are gathered again */
+  static gapCache& getGapCache(apf::Mesh* m, std::vector<int> const& tags) {
+    static gapCache c;
+    size_t ns = tags.size() + 1;
+    if (c.epoch != getTopologyEpoch() || c.mesh != m || c.tags != tags) {
+      c.epoch = getTopologyEpoch();
+      c.mesh = m;
+      c.tags = tags;
+      collectFaces(m, c);
+      c.last.resize(tags.size());
+      for (size_t i = 0; i < tags.size(); i++)
+        c.last[i] = rigidBodyMotion(tags[i]);
+      c.local.assign(ns, std::vector<double>());
+      c.current.assign(ns, std::vector<double>());
+      for (size_t i = 0; i < ns; i++) {
+        localTriangles(m, c.surfaces[i], c.local[i]);
+        gatherTriangles(c.surfaces[i], c.local[i], c.current[i], true);
+        c.surfaces[i].tri = c.current[i];
+        buildTree(c.surfaces[i]);
+      }
+      return c;
+    }
+    std::vector<std::vector<double> > now(ns);
+    std::vector<int> change(ns);
+    for (size_t i = 0; i < ns; i++) {
+      localTriangles(m, c.surfaces[i], now[i]);
+      change[i] = surfaceChange(c.local[i], now[i], i < tags.size() ? &c.last[i] : 0);
+    }
+    PCU_Max_Ints(&change[0], ns);
+    for (size_t i = 0; i < ns; i++) {
+      if (change[i] == SURFACE_MOVED)
+        transformTriangles(makeRigidTransform(c.last[i]), c.current[i]);
+      else if (change[i] == SURFACE_OTHER)
+        gatherTriangles(c.surfaces[i], now[i], c.current[i], false);
+      c.local[i].swap(now[i]);
+    }
+    return c;
+  }
+
+  /* closest point on the triangle abc to p, Ericson 5.1.5 */
+  static void closestOnTriangle(const double* p, const double* a, const double* b,
+      const double* c, double* q) {
+    double ab[3], ac[3], ap[3];
+    for (int d = 0; d < 3; d++) {
+      ab[d] = b[d] - a[d];
+      ac[d] = c[d] - a[d];
+      ap[d] = p[d] - a[d];
+    }
+    double d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+    double d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+    if (d1 <= 0 && d2 <= 0) {
+      std::copy(a, a + 3, q);
+      return;
+    }
+    double bp[3], cp[3];
+    for (int d = 0; d < 3; d++) {
+      bp[d] = p[d] - b[d];
+      cp[d] = p[d] - c[d];
+    }
+    double d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+    double d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+    if (d3 >= 0 && d4 <= d3) {
+      std::copy(b, b + 3, q);
+      return;
+    }
+    double vc = d1*d4 - d3*d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+      double v = d1 / (d1 - d3);
+      for (int d = 0; d < 3; d++) q[d] = a[d] + v * ab[d];
+      return;
+    }
+    double d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+    double d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+    if (d6 >= 0 && d5 <= d6) {
+      std::copy(c, c + 3, q);
+      return;
+    }
+    double vb = d5*d2 - d1*d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+      double w = d2 / (d2 - d6);
+      for (int d = 0; d < 3; d++) q[d] = a[d] + w * ac[d];
+      return;
+    }
+    double va = d3*d6 - d5*d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+      double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+      for (int d = 0; d < 3; d++) q[d] = b[d] + w * (c[d] - b[d]);
+      return;
+    }
+    double denom = 1.0 / (va + vb + vc);
+    double v = vb * denom;
+    double w = vc * denom;
+    for (int d = 0; d < 3; d++) q[d] = a[d] + v * ab[d] + w * ac[d];
+  }
+
+  /* closest points of the segments p1q1 and p2q2, Ericson 5.1.9 */
+  static void closestOnSegments(const double* p1, const double* q1,
+      const double* p2, const double* q2, double* c1, double* c2) {
+    double d1[3], d2[3], r[3];
+    for (int d = 0; d < 3; d++) {
+      d1[d] = q1[d] - p1[d];
+      d2[d] = q2[d] - p2[d];
+      r[d] = p1[d] - p2[d];
+    }
+    double a = d1[0]*d1[0] + d1[1]*d1[1] + d1[2]*d1[2];
+    double e = d2[0]*d2[0] + d2[1]*d2[1] + d2[2]*d2[2];
+    double f = d2[0]*r[0] + d2[1]*r[1] + d2[2]*r[2];
+    double s, t;
+    if (a <= DBL_EPSILON && e <= DBL_EPSILON) {
+      s = t = 0;
+    }
+    else if (a <= DBL_EPSILON) {
+      s = 0;
+      t = std::min(1.0, std::max(0.0, f / e));
+    }
+    else {
+      double c = d1[0]*r[0] + d1[1]*r[1] + d1[2]*r[2];
+      if (e <= DBL_EPSILON) {
+        t = 0;
+        s = std::min(1.0, std::max(0.0, -c / a));
+      }
+      else {
+        double b = d1[0]*d2[0] + d1[1]*d2[1] + d1[2]*d2[2];
+        double denom = a*e - b*b;
+        s = (denom > 0) ? std::min(1.0, std::max(0.0, (b*f - c*e) / denom)) : 0;
+        t = (b*s + f) / e;
+        if (t < 0) {
+          t = 0;
+          s = std::min(1.0, std::max(0.0, -c / a));
+        }
+        else if (t > 1) {
+          t = 1;
+          s = std::min(1.0, std::max(0.0, (b - c) / a));
+        }
+      }
+    }
+    for (int d = 0; d < 3; d++) {
+      c1[d] = p1[d] + s * d1[d];
+      c2[d] = p2[d] + t * d2[d];
+    }
+  }
+
+  static double dist2(const double* a, const double* b) {
+    double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return dx*dx + dy*dy + dz*dz;
+  }
+
+  /* squared distance of two disjoint triangles: the closest pair is a
+     vertex and a face or two edges */
+  static double triangleDistance2(const double* A, const double* B, double* mid) {
+    double best = DBL_MAX;
+    double q[3], c1[3], c2[3];
+    for (int i = 0; i < 3; i++) {
+      closestOnTriangle(A + 3*i, B, B + 3, B + 6, q);
+      double d = dist2(A + 3*i, q);
+      if (d < best) {
+        best = d;
+        for (int k = 0; k < 3; k++) mid[k] = 0.5 * (A[3*i + k] + q[k]);
+      }
+      closestOnTriangle(B + 3*i, A, A + 3, A + 6, q);
+      d = dist2(B + 3*i, q);
+      if (d < best) {
+        best = d;
+        for (int k = 0; k < 3; k++) mid[k] = 0.5 * (B[3*i + k] + q[k]);
+      }
+    }
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++) {
+        closestOnSegments(A + 3*i, A + 3*((i+1)%3), B + 3*j, B + 3*((j+1)%3), c1, c2);
+        double d = dist2(c1, c2);
+        if (d < best) {
+          best = d;
+          for (int k = 0; k < 3; k++) mid[k] = 0.5 * (c1[k] + c2[k]);
+        }
+      }
+    return best;
+  }
+
+  static double boxDistance2(bvhNode const& a, bvhNode const& b) {
+    double s = 0;
+    for (int d = 0; d < 3; d++) {
+      double g = std::max(a.lo[d] - b.hi[d], b.lo[d] - a.hi[d]);
+      if (g > 0) s += g * g;
+    }
+    return s;
+  }
+
+  static double pointBoxDistance2(bvhNode const& b, const double* p) {
+    double s = 0;
+    for (int d = 0; d < 3; d++) {
+      double g = std::max(b.lo[d] - p[d], p[d] - b.hi[d]);
+      if (g > 0) s += g * g;
+    }
+    return s;
+  }
+
+  static double boxSize(bvhNode const& b) {
+    return (b.hi[0] - b.lo[0]) + (b.hi[1] - b.lo[1]) + (b.hi[2] - b.lo[2]);
+  }
+
+  /* simultaneous descent of both trees, pruned by the best gap so far */
+  static void surfaceDistance(gapSurface const& A, gapSurface const& B, gapPair& out) {
+    double best = DBL_MAX;
+    std::vector<std::pair<int,int> > stack(1, std::make_pair(0, 0));
+    double mid[3];
+    while (!stack.empty()) {
+      std::pair<int,int> p = stack.back();
+      stack.pop_back();
+      bvhNode const& a = A.nodes[p.first];
+      bvhNode const& b = B.nodes[p.second];
+      if (boxDistance2(a, b) >= best)
+        continue;
+      if (a.left < 0 && b.left < 0) {
+        for (int i = a.first; i < a.first + a.count; i++)
+          for (int j = b.first; j < b.first + b.count; j++) {
+            double d = triangleDistance2(&A.tri[9 * A.order[i]], &B.tri[9 * B.order[j]], mid);
+            if (d < best) {
+              best = d;
+              std::copy(mid, mid + 3, out.where);
+            }
+          }
+      }
+      else if (b.left < 0 || (a.left >= 0 && boxSize(a) >= boxSize(b))) {
+        stack.push_back(std::make_pair(a.left, p.second));
+        stack.push_back(std::make_pair(a.right, p.second));
+      }
+      else {
+        stack.push_back(std::make_pair(p.first, b.left));
+        stack.push_back(std::make_pair(p.first, b.right));
+      }
+    }
+    out.gap = sqrt(best);
+  }
+
+  double pointDistance(gapSurface const& s, const double* p, double bound) {
+    if (!s.size())
+      return bound;
+    double best = (bound < sqrt(DBL_MAX)) ? bound * bound : DBL_MAX;
+    double q[3];
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+      bvhNode const& b = s.nodes[stack.back()];
+      stack.pop_back();
+      if (pointBoxDistance2(b, p) >= best)
+        continue;
+      if (b.left >= 0) {
+        stack.push_back(b.left);
+        stack.push_back(b.right);
+        continue;
+      }
+      for (int i = b.first; i < b.first + b.count; i++) {
+        const double* t = &s.tri[9 * s.order[i]];
+        closestOnTriangle(p, t, t + 3, t + 6, q);
+        best = std::min(best, dist2(p, q));
+      }
+    }
+    return sqrt(best);
+  }
+
+  std::vector<gapSurface> const& movedSurfaces(apf::Mesh* m,
+      std::vector<rigidBodyMotion> const& rbms) {
+    std::vector<int> tags(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++)
+      tags[i] = rbms[i].tag;
+    gapCache& c = getGapCache(m, tags);
+    for (size_t i = 0; i < rbms.size(); i++) {
+      c.surfaces[i].tri = c.current[i];
+      transformTriangles(makeRigidTransform(rbms[i]), c.surfaces[i].tri);
+      refit(c.surfaces[i]);
+      c.last[i] = rbms[i];
+    }
+    c.surfaces.back().tri = c.current.back();
+    refit(c.surfaces.back());
+    return c.surfaces;
+  }
+
+  /* clear far[i] of the vertices of mb within radius of a body surface */
+  static void markNear(std::vector<gapSurface> const& surfaces, size_t nb,
+      motionBuffer const& mb, double radius, std::vector<char>& far) {
+    parallelFor(mb.size(), [&](size_t b, size_t e, int) {
+      for (size_t i = b; i < e; i++) {
+        if (!far[i]) continue;
+        const double p[3] = {mb.x[0][i], mb.x[1][i], mb.x[2][i]};
+        for (size_t k = 0; k < nb && far[i]; k++)
+          if (pointDistance(surfaces[k], p, radius) < radius)
+            far[i] = 0;
+      }
+    });
+  }
+
+  void findFarVertices(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      motionBuffer const& mb, std::vector<char>& far) {
+    far.clear();
+    double radius = getControl().influenceRadius;
+    if (radius <= 0 || rbms.empty())
+      return;
+    double t0 = PCU_Time();
+    far.assign(mb.size(), 1);
+    /* the vertices of the bodies move with them however far inside */
+    gmi_model* g = m->getModel();
+    std::vector<gmi_ent*> bodies(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++)
+      bodies[i] = gmi_find(g, 3, rbms[i].tag);
+    std::map<gmi_ent*, int> known;
+    for (size_t i = 0; i < mb.size(); i++) {
+      gmi_ent* e = reinterpret_cast<gmi_ent*>(m->toModel(mb.verts[i]));
+      std::map<gmi_ent*, int>::iterator it = known.find(e);
+      if (it == known.end())
+        it = known.insert(std::make_pair(e, surfaceOf(g, e, bodies))).first;
+      if (it->second != (int)bodies.size())
+        far[i] = 0;
+    }
+    std::vector<rigidBodyMotion> still(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++)
+      still[i] = rigidBodyMotion(rbms[i].tag);
+    /* the pending motion last, so the cache expects the bodies to move by it */
+    markNear(movedSurfaces(m, still), rbms.size(), mb, radius, far);
+    markNear(movedSurfaces(m, rbms), rbms.size(), mb, radius, far);
+    long numFar = (long)std::count(far.begin(), far.end(), 1);
+    double t1 = PCU_Time();
+    PC_LOG_TOTAL(PC_LOG_INFO, "vertices beyond the influence radius", numFar);
+    PC_LOG(PC_LOG_INFO, "found the vertices beyond the influence radius in %f seconds\n", t1 - t0);
+  }
+
+  gapReport measureGaps(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms) {
+    std::vector<gapSurface> const& surfaces = movedSurfaces(m, rbms);
+    /* every body against the bodies after it and the static faces */
+    gapReport r;
+    std::vector<int> pairSurfaces;
+    size_t ns = surfaces.size();
+    for (size_t i = 0; i + 1 < ns; i++)
+      for (size_t j = i + 1; j < ns; j++) {
+        if (!surfaces[i].size() || !surfaces[j].size())
+          continue;
+        gapPair p;
+        p.a = surfaces[i].tag;
+        p.b = surfaces[j].tag;
+        p.gap = 0;
+        p.where[0] = p.where[1] = p.where[2] = 0;
+        r.pairs.push_back(p);
+        pairSurfaces.push_back((int)i);
+        pairSurfaces.push_back((int)j);
+      }
+    /* the pairs are split over the parts and their threads, then summed */
+    int self = PCU_Comm_Self();
+    int peers = PCU_Comm_Peers();
+    std::vector<int> mine;
+    for (size_t k = self; k < r.pairs.size(); k += peers)
+      mine.push_back((int)k);
+    parallelFor(mine.size(), [&](size_t b, size_t e, int) {
+      for (size_t k = b; k < e; k++) {
+        int q = mine[k];
+        surfaceDistance(surfaces[pairSurfaces[2*q]], surfaces[pairSurfaces[2*q+1]],
+            r.pairs[q]);
+      }
+    });
+    std::vector<double> vals(4 * r.pairs.size());
+    for (size_t k = 0; k < r.pairs.size(); k++) {
+      vals[4*k] = r.pairs[k].gap;
+      std::copy(r.pairs[k].where, r.pairs[k].where + 3, &vals[4*k + 1]);
+    }
+    if (!vals.empty())
+      MPI_Allreduce(MPI_IN_PLACE, &vals[0], (int)vals.size(), MPI_DOUBLE, MPI_SUM,
+          PCU_Get_Comm());
+    r.minGap = -1;
+    for (size_t k = 0; k < r.pairs.size(); k++) {
+      r.pairs[k].gap = vals[4*k];
+      std::copy(&vals[4*k + 1], &vals[4*k + 4], r.pairs[k].where);
+      if (r.minGap < 0 || r.pairs[k].gap < r.minGap)
+        r.minGap = r.pairs[k].gap;
+    }
+    return r;
+  }
+
+  static void printSurfaceName(char* buf, size_t n, int tag) {
+    if (tag < 0)
+      snprintf(buf, n, "static faces");
+    else
+      snprintf(buf, n, "body %d", tag);
+  }
+
+  void printGapReport(gapReport const& r) {
+    char a[32], b[32];
+    for (size_t k = 0; k < r.pairs.size(); k++) {
+      gapPair const& p = r.pairs[k];
+      printSurfaceName(a, sizeof a, p.a);
+      printSurfaceName(b, sizeof b, p.b);
+      PC_LOG(PC_LOG_INFO, "gap %s - %s: %e at (%f, %f, %f)\n",
+          a, b, p.gap, p.where[0], p.where[1], p.where[2]);
+    }
+  }
+
+  bool stopForGap(ph::Input& in, apf::Mesh* m, int step) {
+    control const& c = getControl();
+    if (!c.gapReport && c.gapStop <= 0)
+      return false;
+    double t0 = PCU_Time();
+    gapReport r = measureGaps(m, getRigidBodyMotions(in));
+    double t1 = PCU_Time();
+    if (c.gapReport) {
+      PC_LOG(PC_LOG_INFO, "step %d: measured %lu gaps in %f seconds\n",
+          step, (unsigned long)r.pairs.size(), t1 - t0);
+      printGapReport(r);
+    }
+    if (c.gapStop > 0 && r.minGap >= 0 && r.minGap < c.gapStop) {
+      PC_LOG(PC_LOG_WARN, "step %d: gap %e is below pcGapStop %e, stopping before the mesh motion\n",
+          step, r.minGap, c.gapStop);
+      return true;
+    }
+    return false;
+  }
+
+}
@@ -0,0 +1,80 @@
+#ifndef PC_PROXIMITY_H
+#define PC_PROXIMITY_H
+
+#include "pcUpdateMesh.h"
+#include "pcMotionBuffer.h"
+#include <apf.h>
+#include <apfMesh2.h>
+#include <cfloat>
+#include <vector>
+
+namespace pc {
+
+  struct bvhNode {
+    double lo[3], hi[3];
+    int left, right;  // children, -1 for a leaf
+    int first, count; // leaf triangles: order[first] .. order[first+count-1]
+  };
+
+  /* boundary triangles of one rigid body closure, or of the static
+     model faces, gathered from all parts once per topology epoch. A
+     body surface then follows the body transforms locally and is only
+     gathered again if its part copies moved otherwise. The tree is built
+     with the gather and refit to the moved triangles every call */
+  struct gapSurface {
+    int tag;                             // rigid body tag, -1 for static faces
+    std::vector<apf::MeshEntity*> faces; // owned local faces, in gather order
+    std::vector<double> tri;             // 9 coordinates per triangle, all parts
+    std::vector<int> counts;             // coordinates contributed by each part
+    std::vector<int> order;
+    std::vector<bvhNode> nodes;          // children follow their parent
+    size_t size() const { return tri.size() / 9; }
+  };
+
+  struct gapPair {
+    int a, b;        // rigid body tags, -1 for static faces
+    double gap;      // minimum triangle distance
+    double where[3]; // midpoint of the closest points
+  };
+
+  struct gapReport {
+    std::vector<gapPair> pairs;
+    double minGap; // over all pairs, -1 if there are none
+  };
+
+  /* collective; gaps between every pair of rigid bodies and between each
+     body and the static faces, after applying the pending rigid body
+     transforms rbms to the current coordinates. Triangles sharing a
+     vertex across two surfaces are left out, so touching surfaces do not
+     report a zero gap. Intersecting triangles are not detected */
+  gapReport measureGaps(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms);
+
+  /* collective; the surfaces of the bodies in rbms order and then the
+     static faces, moved by the pending transforms and refit. Valid
+     until the next call. The transforms of the last call before the
+     mesh moves are the ones the next call expects the bodies to have
+     moved by */
+  std::vector<gapSurface> const& movedSurfaces(apf::Mesh* m,
+      std::vector<rigidBodyMotion> const& rbms);
+
+  /* distance from p to the nearest triangle of s, or bound if none is
+     closer than bound */
+  double pointDistance(gapSurface const& s, const double* p, double bound = DBL_MAX);
+
+  /* collective; far[i] = 1 for the vertices of mb farther than
+     pcInfluenceRadius from every rigid body surface, both before and
+     after the pending motion rbms. Empty if the radius is 0 or there
+     are no bodies */
+  void findFarVertices(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      motionBuffer const& mb, std::vector<char>& far);
+
+  void printGapReport(gapReport const& r);
+
+  /* collective; measures the gaps ahead of the mesh motion of this step
+     when pcGapReport or pcGapStop is set, and returns true if one closes
+     below pcGapStop so the loop can stop before moving the mesh */
+  bool stopForGap(ph::Input& in, apf::Mesh* m, int step);
+
+}
+
+#endif
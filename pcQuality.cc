@@ -0,0 +1,402 @@
+#include "pcQuality.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace pc {
+
+  static const int tetSplit[1][4] = {{0,1,2,3}};
+  static const int prismSplit[3][4] = {{0,1,2,3},{1,2,3,4},{2,3,4,5}};
+  static const int pyramidSplit[2][4] = {{0,1,2,4},{0,2,3,4}};
+
+  int getTetSplit(int type, const int (**split)[4]) {
+    switch (type) {
+      case apf::Mesh::TET:     *split = tetSplit;     return 1;
+      case apf::Mesh::PRISM:   *split = prismSplit;   return 3;
+      case apf::Mesh::PYRAMID: *split = pyramidSplit; return 2;
+      default:                 *split = 0;            return 0;
+    }
+  }
+
+  static double tetVolume(const double* a, const double* b,
+      const double* c, const double* d) {
+    double u[3], v[3], w[3];
+    for (int i = 0; i < 3; i++) {
+      u[i] = b[i] - a[i];
+      v[i] = c[i] - a[i];
+      w[i] = d[i] - a[i];
+    }
+    return ( (u[1]*v[2] - u[2]*v[1]) * w[0]
+           + (u[2]*v[0] - u[0]*v[2]) * w[1]
+           + (u[0]*v[1] - u[1]*v[0]) * w[2] ) / 6.0;
+  }
+
+  static double tetQuality(const double* x, double volume) {
+    static const int edges[6][2] = {{0,1},{1,2},{2,0},{0,3},{1,3},{2,3}};
+    double l2 = 0;
+    for (int e = 0; e < 6; e++)
+      for (int d = 0; d < 3; d++) {
+        double dx = x[3*edges[e][1]+d] - x[3*edges[e][0]+d];
+        l2 += dx*dx;
+      }
+    double lrms = sqrt(l2 / 6.0);
+    if (lrms == 0) return 0;
+    return 6.0 * sqrt(2.0) * volume / (lrms*lrms*lrms);
+  }
+
+  /* smallest orientation corrected sub-tet volume of element i */
+  static double elementVolume(elementCoords const& ec, size_t i, double sign) {
+    const int (*split)[4];
+    int n = getTetSplit(ec.type[i], &split);
+    const double* x = &ec.xyz[3*ec.offset[i]];
+    double v = DBL_MAX;
+    for (int t = 0; t < n; t++) {
+      double vt = sign * tetVolume(x + 3*split[t][0], x + 3*split[t][1],
+                                   x + 3*split[t][2], x + 3*split[t][3]);
+      if (vt < v) v = vt;
+    }
+    return v;
+  }
+
+  double elementTotalVolume(elementCoords const& ec, size_t i) {
+    const int (*split)[4];
+    int n = getTetSplit(ec.type[i], &split);
+    const double* x = &ec.xyz[3*ec.offset[i]];
+    double v = 0;
+    for (int t = 0; t < n; t++)
+      v += tetVolume(x + 3*split[t][0], x + 3*split[t][1],
+                     x + 3*split[t][2], x + 3*split[t][3]);
+    return fabs(v);
+  }
+
+  static void centroid(elementCoords const& ec, size_t i, double* c) {
+    int nv = ec.offset[i+1] - ec.offset[i];
+    const double* x = &ec.xyz[3*ec.offset[i]];
+    for (int d = 0; d < 3; d++) {
+      c[d] = 0;
+      for (int v = 0; v < nv; v++)
+        c[d] += x[3*v+d];
+      c[d] /= nv;
+    }
+  }
+
+  void extractElementCoords(apf::Mesh* m, elementCoords& ec) {
+    size_t n = m->count(m->getDimension());
+    ec.elms.clear();
+    ec.type.clear();
+    ec.offset.clear();
+    ec.xyz.clear();
+    ec.elms.reserve(n);
+    ec.type.reserve(n);
+    ec.offset.reserve(n+1);
+    ec.xyz.reserve(3*4*n);
+    ec.offset.push_back(0);
+    apf::Downward verts;
+    apf::Vector3 p;
+    apf::MeshEntity* e;
+    apf::MeshIterator* itr = m->begin(m->getDimension());
+    while( (e = m->iterate(itr)) ) {
+      int nv = m->getDownward(e, 0, verts);
+      ec.elms.push_back(e);
+      ec.type.push_back(m->getType(e));
+      for (int v = 0; v < nv; v++) {
+        m->getPoint(verts[v], 0, p);
+        for (int d = 0; d < 3; d++)
+          ec.xyz.push_back(p[d]);
+      }
+      ec.offset.push_back(ec.offset.back() + nv);
+    }
+    m->end(itr);
+  }
+
+  double elementOrientation(elementCoords const& ec) {
+    static long epoch = -1;
+    static double sign = 1.0;
+    if (epoch == getTopologyEpoch())
+      return sign;
+    int nt = getNumThreads();
+    std::vector<long> counts(2*nt, 0);
+    parallelFor(ec.size(), [&](size_t b, size_t e, int t) {
+      long pos = 0, neg = 0;
+      for (size_t i = b; i < e; i++) {
+        if (elementVolume(ec, i, 1.0) > 0) pos++;
+        else if (elementVolume(ec, i, -1.0) > 0) neg++;
+      }
+      counts[2*t] = pos;
+      counts[2*t+1] = neg;
+    });
+    long total[2] = {0, 0};
+    for (int t = 0; t < nt; t++) {
+      total[0] += counts[2*t];
+      total[1] += counts[2*t+1];
+    }
+    PCU_Add_Longs(total, 2);
+    sign = (total[1] > total[0]) ? -1.0 : 1.0;
+    epoch = getTopologyEpoch();
+    PC_LOG(PC_LOG_DEBUG, "element orientation %+.0f (%ld positive, %ld negative)\n",
+        sign, total[0], total[1]);
+    return sign;
+  }
+
+  struct threadScan {
+    long numInvalid;
+    long histogram[QUALITY_BINS];
+    double minQuality;
+    long worstQuality;
+    double minVolume;
+    long worstVolume;
+  };
+
+  /* owner of the global minimum broadcasts the centroid of its element */
+  static void reduceLocation(elementCoords const& ec, double local,
+      double global, long elm, double* loc) {
+    int self = PCU_Comm_Self();
+    int owner = PCU_Min_Int((local == global && elm >= 0) ? self : PCU_Comm_Peers());
+    loc[0] = loc[1] = loc[2] = 0;
+    if (owner == self)
+      centroid(ec, elm, loc);
+    PCU_Add_Doubles(loc, 3);
+  }
+
+  void scanQuality(elementCoords const& ec, qualityReport& r, bool passFail) {
+    double sign = elementOrientation(ec);
+    int nt = getNumThreads();
+    std::vector<threadScan> scans(nt);
+    for (int t = 0; t < nt; t++) {
+      threadScan& s = scans[t];
+      s.numInvalid = 0;
+      for (int k = 0; k < QUALITY_BINS; k++)
+        s.histogram[k] = 0;
+      s.minQuality = DBL_MAX;
+      s.worstQuality = -1;
+      s.minVolume = DBL_MAX;
+      s.worstVolume = -1;
+    }
+    std::atomic<bool> stop(false);
+    parallelFor(ec.size(), [&](size_t b, size_t e, int t) {
+      threadScan& s = scans[t];
+      for (size_t i = b; i < e; i++) {
+        if (passFail && stop.load(std::memory_order_relaxed))
+          return;
+        double v = elementVolume(ec, i, sign);
+        if (v < s.minVolume) {
+          s.minVolume = v;
+          s.worstVolume = (long)i;
+        }
+        if (v <= 0) {
+          s.numInvalid++;
+          if (passFail) {
+            stop.store(true, std::memory_order_relaxed);
+            return;
+          }
+        }
+        if (passFail || ec.type[i] != apf::Mesh::TET)
+          continue;
+        double q = tetQuality(&ec.xyz[3*ec.offset[i]], v);
+        int bin = (int)(q * QUALITY_BINS);
+        if (bin < 0) bin = 0;
+        if (bin >= QUALITY_BINS) bin = QUALITY_BINS - 1;
+        s.histogram[bin]++;
+        if (q < s.minQuality) {
+          s.minQuality = q;
+          s.worstQuality = (long)i;
+        }
+      }
+    });
+    r.numElements = (long)ec.size();
+    r.numInvalid = 0;
+    for (int k = 0; k < QUALITY_BINS; k++)
+      r.histogram[k] = 0;
+    double minQuality = DBL_MAX;
+    double minVolume = DBL_MAX;
+    long worstQuality = -1;
+    long worstVolume = -1;
+    for (int t = 0; t < nt; t++) {
+      threadScan const& s = scans[t];
+      r.numInvalid += s.numInvalid;
+      for (int k = 0; k < QUALITY_BINS; k++)
+        r.histogram[k] += s.histogram[k];
+      if (s.minQuality < minQuality) {
+        minQuality = s.minQuality;
+        worstQuality = s.worstQuality;
+      }
+      if (s.minVolume < minVolume) {
+        minVolume = s.minVolume;
+        worstVolume = s.worstVolume;
+      }
+    }
+    r.numElements = PCU_Add_Long(r.numElements);
+    r.numInvalid = PCU_Add_Long(r.numInvalid);
+    if (passFail)
+      return;
+    PCU_Add_Longs(r.histogram, QUALITY_BINS);
+    r.minQuality = PCU_Min_Double(minQuality);
+    r.minVolume = PCU_Min_Double(minVolume);
+    reduceLocation(ec, minQuality, r.minQuality, worstQuality, r.worstLocation);
+    reduceLocation(ec, minVolume, r.minVolume, worstVolume, r.invalidLocation);
+  }
+
+  void scanQuality(apf::Mesh* m, qualityReport& r, bool passFail) {
+    double t0 = PCU_Time();
+    elementCoords ec;
+    extractElementCoords(m, ec);
+    scanQuality(ec, r, passFail);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_DEBUG, "quality scan on %d threads in %f seconds\n",
+        getNumThreads(), t1 - t0);
+  }
+
+  bool isMeshValid(apf::Mesh* m) {
+    qualityReport r;
+    scanQuality(m, r, true);
+    return r.numInvalid == 0;
+  }
+
+  void printQualityReport(qualityReport const& r) {
+    PC_LOG(PC_LOG_INFO, "quality scan: %ld elements, %ld invalid\n",
+        r.numElements, r.numInvalid);
+    PC_LOG(PC_LOG_INFO, "  min volume %e at (%f, %f, %f)\n", r.minVolume,
+        r.invalidLocation[0], r.invalidLocation[1], r.invalidLocation[2]);
+    PC_LOG(PC_LOG_INFO, "  min tet shape %f at (%f, %f, %f)\n", r.minQuality,
+        r.worstLocation[0], r.worstLocation[1], r.worstLocation[2]);
+    for (int k = 0; k < QUALITY_BINS; k++)
+      PC_LOG(PC_LOG_INFO, "  shape [%.1f,%.1f): %ld\n",
+          (double)k / QUALITY_BINS, (double)(k+1) / QUALITY_BINS, r.histogram[k]);
+  }
+
+  void findBadElements(elementCoords const& ec, double minQuality,
+      std::vector<int>& bad) {
+    double sign = elementOrientation(ec);
+    int nt = getNumThreads();
+    std::vector<std::vector<int> > found(nt);
+    parallelFor(ec.size(), [&](size_t b, size_t e, int t) {
+      for (size_t i = b; i < e; i++) {
+        double v = elementVolume(ec, i, sign);
+        if (v <= 0 || (ec.type[i] == apf::Mesh::TET &&
+              tetQuality(&ec.xyz[3*ec.offset[i]], v) < minQuality))
+          found[t].push_back((int)i);
+      }
+    });
+    bad.clear();
+    for (int t = 0; t < nt; t++)
+      bad.insert(bad.end(), found[t].begin(), found[t].end());
+  }
+
+  void extractElementMotion(apf::Mesh* m, elementCoords const& ec,
+      std::unordered_map<apf::MeshEntity*, int> const& index,
+      motionBuffer const& mb, std::vector<double>& disp) {
+    disp.assign(ec.xyz.size(), 0.0);
+    apf::Downward verts;
+    for (size_t i = 0; i < ec.size(); i++) {
+      int nv = m->getDownward(ec.elms[i], 0, verts);
+      double* u = &disp[3*ec.offset[i]];
+      for (int v = 0; v < nv; v++) {
+        std::unordered_map<apf::MeshEntity*, int>::const_iterator it = index.find(verts[v]);
+        if (it == index.end())
+          continue;
+        for (int d = 0; d < 3; d++)
+          u[3*v+d] = mb.disp[d][it->second];
+      }
+    }
+  }
+
+  static double det3(const double* a, const double* b, const double* c) {
+    return (a[1]*b[2] - a[2]*b[1]) * c[0]
+         + (a[2]*b[0] - a[0]*b[2]) * c[1]
+         + (a[0]*b[1] - a[1]*b[0]) * c[2];
+  }
+
+  static double cubic(const double* c, double t) {
+    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+  }
+
+  /* first zero in [0,1] of a cubic positive at 0, or 2; the cubic is
+     monotone between its critical points, so the first bracket found
+     is bisected */
+  static double firstZero(const double* c) {
+    if (c[0] <= 0)
+      return 0;
+    double pts[3];
+    int n = 0;
+    double A = 3 * c[3], B = 2 * c[2], C = c[1];
+    if (fabs(A) <= 1e-14 * (fabs(B) + fabs(C))) {
+      if (B != 0)
+        pts[n++] = -C / B;
+    }
+    else {
+      double disc = B*B - 4*A*C;
+      if (disc >= 0) {
+        double q = -0.5 * (B + (B < 0 ? -1 : 1) * sqrt(disc));
+        pts[n++] = q / A;
+        if (q != 0)
+          pts[n++] = C / q;
+      }
+    }
+    int m = 0;
+    for (int i = 0; i < n; i++)
+      if (pts[i] > 0 && pts[i] < 1)
+        pts[m++] = pts[i];
+    std::sort(pts, pts + m);
+    pts[m++] = 1;
+    double a = 0;
+    for (int i = 0; i < m; i++) {
+      double b = pts[i];
+      if (cubic(c, b) <= 0) {
+        for (int it = 0; it < 60; it++) {
+          double mid = 0.5 * (a + b);
+          if (cubic(c, mid) > 0)
+            a = mid;
+          else
+            b = mid;
+        }
+        return b;
+      }
+      a = b;
+    }
+    return 2;
+  }
+
+  double invertingFraction(elementCoords const& ec, std::vector<double> const& disp) {
+    assert(disp.size() == ec.xyz.size());
+    double sign = elementOrientation(ec);
+    std::vector<double> partial(getNumThreads(), 2.0);
+    parallelFor(ec.size(), [&](size_t b, size_t e, int t) {
+      double first = 2;
+      for (size_t i = b; i < e; i++) {
+        const int (*split)[4];
+        int n = getTetSplit(ec.type[i], &split);
+        const double* x = &ec.xyz[3*ec.offset[i]];
+        const double* u = &disp[3*ec.offset[i]];
+        for (int s = 0; s < n; s++) {
+          double ev[3][3], fv[3][3];
+          const int* v = split[s];
+          for (int k = 0; k < 3; k++)
+            for (int d = 0; d < 3; d++) {
+              ev[k][d] = x[3*v[k+1]+d] - x[3*v[0]+d];
+              fv[k][d] = u[3*v[k+1]+d] - u[3*v[0]+d];
+            }
+          double c[4];
+          c[0] = det3(ev[0], ev[1], ev[2]);
+          c[1] = det3(fv[0], ev[1], ev[2]) + det3(ev[0], fv[1], ev[2]) + det3(ev[0], ev[1], fv[2]);
+          c[2] = det3(ev[0], fv[1], fv[2]) + det3(fv[0], ev[1], fv[2]) + det3(fv[0], fv[1], ev[2]);
+          c[3] = det3(fv[0], fv[1], fv[2]);
+          for (int k = 0; k < 4; k++)
+            c[k] *= sign;
+          first = std::min(first, firstZero(c));
+        }
+      }
+      partial[t] = first;
+    });
+    double first = 2;
+    for (size_t t = 0; t < partial.size(); t++)
+      first = std::min(first, partial[t]);
+    return PCU_Min_Double(first);
+  }
+
+}
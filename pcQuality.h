@@ -0,0 +1,85 @@
+#ifndef PC_QUALITY_H
+#define PC_QUALITY_H
+
+#include "pcMotionBuffer.h"
+#include <apf.h>
+#include <apfMesh2.h>
+#include <unordered_map>
+#include <vector>
+
+namespace pc {
+
+  /* vertex coordinates of every local element, extracted once so the
+     scan threads never touch the mesh database */
+  struct elementCoords {
+    std::vector<apf::MeshEntity*> elms;
+    std::vector<int> type;     // apf::Mesh::Type
+    std::vector<int> offset;   // first vertex of element i, size elms+1
+    std::vector<double> xyz;   // 3 doubles per element vertex
+    size_t size() const { return elms.size(); }
+  };
+
+  void extractElementCoords(apf::Mesh* m, elementCoords& ec);
+
+  /* split of an element type into tets with the orientation of the tet
+     (0,1,2,3), so a valid element has all sub-volumes of one sign;
+     returns the number of tets, 0 for unsupported types */
+  int getTetSplit(int type, const int (**split)[4]);
+
+  /* unsigned volume of element i, the sum of its split tets; 0 for
+     unsupported types */
+  double elementTotalVolume(elementCoords const& ec, size_t i);
+
+  /* collective; the vertex ordering convention differs between mesh
+     databases, so the sign of a valid element is taken from the majority
+     of the elements the first time a topology is scanned and reused
+     until it changes */
+  double elementOrientation(elementCoords const& ec);
+
+  enum { QUALITY_BINS = 10 };
+
+  /* global result of a scan; the shape metric is the volume-length
+     ratio 6*sqrt(2)*V/l_rms^3 (1 for the equilateral tet) and is only
+     accumulated over tets, boundary layer prisms and pyramids are only
+     checked for validity */
+  struct qualityReport {
+    long numElements;
+    long numInvalid;
+    long histogram[QUALITY_BINS]; // tets per uniform bin of [0,1]
+    double minQuality;
+    double worstLocation[3];      // centroid of the lowest quality tet
+    double minVolume;             // smallest signed volume, orientation corrected
+    double invalidLocation[3];    // centroid of the worst invalid element
+  };
+
+  /* collective; with passFail set every rank stops at its first invalid
+     element and only numInvalid > 0 is meaningful */
+  void scanQuality(elementCoords const& ec, qualityReport& r, bool passFail = false);
+
+  void scanQuality(apf::Mesh* m, qualityReport& r, bool passFail = false);
+
+  /* collective pass/fail check; with pcAdaptOnInvalid updateMesh only
+     adapts a moved mesh that fails it */
+  bool isMeshValid(apf::Mesh* m);
+
+  void printQualityReport(qualityReport const& r);
+
+  /* collective through elementOrientation; local elements that are
+     invalid or tets with a shape below minQuality, in ec order */
+  void findBadElements(elementCoords const& ec, double minQuality,
+      std::vector<int>& bad);
+
+  /* displacement of every element vertex, laid out like ec.xyz; index
+     maps a vertex to its position in mb, other vertices do not move */
+  void extractElementMotion(apf::Mesh* m, elementCoords const& ec,
+      std::unordered_map<apf::MeshEntity*, int> const& index,
+      motionBuffer const& mb, std::vector<double>& disp);
+
+  /* collective; moving the vertices linearly by t*disp makes every
+     sub-tet volume a cubic in t. Returns the smallest t in [0,1] at which
+     one of them reaches zero, or 2 if no element inverts along the way */
+  double invertingFraction(elementCoords const& ec, std::vector<double> const& disp);
+
+}
+
+#endif
@@ -0,0 +1,381 @@
+#include "pcRbfMover.h"
+#include "pcControl.h"
+#include "pcElasticMover.h"
+#include "pcLog.h"
+#include "pcMotionBuffer.h"
+#include "pcMoverSystem.h"
+#include "pcProximity.h"
+#include "pcRigidTransform.h"
+#include "pcUpdateMesh.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <mpi.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace pc {
+
+  /* Wendland C2 in 3D, positive definite for r in [0,1] */
+  static inline double wendland(double r) {
+    double t = std::max(0.0, 1.0 - r);
+    double t2 = t * t;
+    return t2 * t2 * (4.0 * r + 1.0);
+  }
+
+  /* sort the centers into grid cells; the cell size grows past the
+     radius if the grid would have far more cells than centers */
+  static void fillGrid(rbfInterpolant& rbf, std::vector<double> const* c,
+      std::vector<double> const* w) {
+    size_t n = c[0].size();
+    if (!n) {
+      rbf.h = 1;
+      for (int d = 0; d < 3; d++) {
+        rbf.lo[d] = 0;
+        rbf.dims[d] = 1;
+        rbf.c[d].clear();
+        rbf.w[d].clear();
+      }
+      rbf.cellStart.assign(2, 0);
+      return;
+    }
+    double hi[3];
+    for (int d = 0; d < 3; d++) {
+      rbf.lo[d] = DBL_MAX;
+      hi[d] = -DBL_MAX;
+      for (size_t i = 0; i < n; i++) {
+        rbf.lo[d] = std::min(rbf.lo[d], c[d][i]);
+        hi[d] = std::max(hi[d], c[d][i]);
+      }
+    }
+    rbf.h = rbf.radius;
+    double maxCells = 8.0 * n + 64;
+    for (;;) {
+      double cells = 1;
+      for (int d = 0; d < 3; d++)
+        cells *= floor((hi[d] - rbf.lo[d]) / rbf.h) + 1;
+      if (cells <= maxCells)
+        break;
+      rbf.h *= 2;
+    }
+    for (int d = 0; d < 3; d++)
+      rbf.dims[d] = (int)floor((hi[d] - rbf.lo[d]) / rbf.h) + 1;
+    size_t ncell = (size_t)rbf.dims[0] * rbf.dims[1] * rbf.dims[2];
+    std::vector<size_t> cellOf(n);
+    rbf.cellStart.assign(ncell + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+      int ijk[3];
+      for (int d = 0; d < 3; d++)
+        ijk[d] = std::min(rbf.dims[d] - 1, (int)((c[d][i] - rbf.lo[d]) / rbf.h));
+      cellOf[i] = ((size_t)ijk[2] * rbf.dims[1] + ijk[1]) * rbf.dims[0] + ijk[0];
+      rbf.cellStart[cellOf[i] + 1]++;
+    }
+    for (size_t k = 0; k < ncell; k++)
+      rbf.cellStart[k+1] += rbf.cellStart[k];
+    std::vector<int> fill(rbf.cellStart.begin(), rbf.cellStart.end() - 1);
+    for (int d = 0; d < 3; d++) {
+      rbf.c[d].resize(n);
+      rbf.w[d].resize(n);
+    }
+    for (size_t i = 0; i < n; i++) {
+      int at = fill[cellOf[i]]++;
+      for (int d = 0; d < 3; d++) {
+        rbf.c[d][at] = c[d][i];
+        rbf.w[d][at] = w[d][i];
+      }
+    }
+  }
+
+  static void evalPoint(rbfInterpolant const& rbf, const double* p, double* out) {
+    out[0] = out[1] = out[2] = 0;
+    if (!rbf.size())
+      return;
+    int ijk[3];
+    for (int d = 0; d < 3; d++)
+      ijk[d] = (int)floor((p[d] - rbf.lo[d]) / rbf.h);
+    const double inv = 1.0 / rbf.radius;
+    const double* cx = &rbf.c[0][0];
+    const double* cy = &rbf.c[1][0];
+    const double* cz = &rbf.c[2][0];
+    const double* w0 = &rbf.w[0][0];
+    const double* w1 = &rbf.w[1][0];
+    const double* w2 = &rbf.w[2][0];
+    for (int k = ijk[2] - 1; k <= ijk[2] + 1; k++) {
+      if (k < 0 || k >= rbf.dims[2]) continue;
+      for (int j = ijk[1] - 1; j <= ijk[1] + 1; j++) {
+        if (j < 0 || j >= rbf.dims[1]) continue;
+        int i0 = std::max(ijk[0] - 1, 0);
+        int i1 = std::min(ijk[0] + 1, rbf.dims[0] - 1);
+        if (i0 > i1) continue;
+        /* the cells i0..i1 of a grid row are contiguous */
+        size_t row = ((size_t)k * rbf.dims[1] + j) * rbf.dims[0];
+        int b = rbf.cellStart[row + i0];
+        int e = rbf.cellStart[row + i1 + 1];
+        double s0 = 0, s1 = 0, s2 = 0;
+        for (int c = b; c < e; c++) {
+          double dx = p[0] - cx[c], dy = p[1] - cy[c], dz = p[2] - cz[c];
+          double phi = wendland(sqrt(dx*dx + dy*dy + dz*dz) * inv);
+          s0 += phi * w0[c];
+          s1 += phi * w1[c];
+          s2 += phi * w2[c];
+        }
+        out[0] += s0;
+        out[1] += s1;
+        out[2] += s2;
+      }
+    }
+  }
+
+  void evalRbf(rbfInterpolant const& rbf, size_t n,
+      const double* const x[3], double* const out[3]) {
+    parallelFor(n, [&](size_t b, size_t e, int) {
+      double p[3], v[3];
+      for (size_t i = b; i < e; i++) {
+        for (int d = 0; d < 3; d++)
+          p[d] = x[d][i];
+        evalPoint(rbf, p, v);
+        for (int d = 0; d < 3; d++)
+          out[d][i] = v[d];
+      }
+    });
+  }
+
+  void buildRbfInterpolant(std::vector<double> const* x, std::vector<double> const* d,
+      double radius, double tol, int maxCenters, rbfInterpolant& rbf) {
+    size_t n = x[0].size();
+    rbf.radius = radius;
+    std::vector<double> c[3], w[3];
+    double maxd = 0;
+    for (size_t i = 0; i < n; i++)
+      maxd = std::max(maxd, sqrt(d[0][i]*d[0][i] + d[1][i]*d[1][i] + d[2][i]*d[2][i]));
+    if (maxd == 0) {
+      fillGrid(rbf, c, w);
+      return;
+    }
+    std::vector<int> sel;
+    std::vector<char> used(n, 0);
+    std::vector<double> L;   // packed lower triangle of the Cholesky factor
+    std::vector<double> err(n);
+    for (size_t i = 0; i < n; i++)
+      err[i] = sqrt(d[0][i]*d[0][i] + d[1][i]*d[1][i] + d[2][i]*d[2][i]);
+    std::vector<double> fit[3];
+    for (int k = 0; k < 3; k++)
+      fit[k].resize(n);
+    std::vector<int> order(n);
+    while ((int)sel.size() < maxCenters) {
+      /* the worst points still out of tolerance */
+      for (size_t i = 0; i < n; i++)
+        order[i] = (int)i;
+      size_t batch = std::max<size_t>(1, std::min<size_t>(256, sel.size() / 4));
+      batch = std::min(batch, (size_t)maxCenters - sel.size());
+      batch = std::min(batch, n);
+      std::partial_sort(order.begin(), order.begin() + batch, order.end(),
+          [&](int a, int b) { return err[a] > err[b] || (err[a] == err[b] && a < b); });
+      size_t added = 0;
+      for (size_t q = 0; q < batch; q++) {
+        int p = order[q];
+        if (used[p] || err[p] <= tol * maxd)
+          continue;
+        used[p] = 1;
+        /* append a row to the factor: L l = k, diagonal sqrt(1 - l.l) */
+        size_t m = sel.size();
+        std::vector<double> l(m);
+        for (size_t j = 0; j < m; j++) {
+          double dx = x[0][p] - x[0][sel[j]];
+          double dy = x[1][p] - x[1][sel[j]];
+          double dz = x[2][p] - x[2][sel[j]];
+          double s = wendland(sqrt(dx*dx + dy*dy + dz*dz) / radius);
+          const double* Lj = &L[j*(j+1)/2];
+          for (size_t k = 0; k < j; k++)
+            s -= Lj[k] * l[k];
+          l[j] = s / Lj[j];
+        }
+        double diag = 1.0 + 1e-12;
+        for (size_t j = 0; j < m; j++)
+          diag -= l[j] * l[j];
+        if (diag <= 1e-10)
+          continue; // numerically a duplicate of the selected centers
+        L.insert(L.end(), l.begin(), l.end());
+        L.push_back(sqrt(diag));
+        sel.push_back(p);
+        added++;
+      }
+      if (!added)
+        break;
+      /* weights by forward and back substitution */
+      size_t m = sel.size();
+      for (int k = 0; k < 3; k++) {
+        c[k].resize(m);
+        w[k].resize(m);
+        for (size_t j = 0; j < m; j++) {
+          c[k][j] = x[k][sel[j]];
+          double s = d[k][sel[j]];
+          const double* Lj = &L[j*(j+1)/2];
+          for (size_t i = 0; i < j; i++)
+            s -= Lj[i] * w[k][i];
+          w[k][j] = s / Lj[j];
+        }
+        for (size_t j = m; j-- > 0; ) {
+          double s = w[k][j];
+          for (size_t i = j + 1; i < m; i++)
+            s -= L[i*(i+1)/2 + j] * w[k][i];
+          w[k][j] = s / L[j*(j+1)/2 + j];
+        }
+      }
+      fillGrid(rbf, c, w);
+      if ((int)m >= maxCenters)
+        break;
+      const double* const xp[3] = {&x[0][0], &x[1][0], &x[2][0]};
+      double* const fp[3] = {&fit[0][0], &fit[1][0], &fit[2][0]};
+      evalRbf(rbf, n, xp, fp);
+      for (size_t i = 0; i < n; i++) {
+        double e2 = 0;
+        for (int k = 0; k < 3; k++)
+          e2 += (d[k][i] - fit[k][i]) * (d[k][i] - fit[k][i]);
+        err[i] = sqrt(e2);
+      }
+    }
+    fillGrid(rbf, c, w);
+  }
+
+  /* rank 0 receives the owned boundary points of every part that move,
+     and one in sampleStride of those that stay, in rank order; the
+     bounding box is reduced over all owned boundary points */
+  static void gatherBoundaryPoints(moverSystem const& s, motionBuffer const& mb,
+      int sampleStride, std::vector<double>* x, std::vector<double>* d,
+      double* lo, double* hi) {
+    std::vector<double> local;
+    long numFixed = 0;
+    for (int k = 0; k < 3; k++) {
+      lo[k] = DBL_MAX;
+      hi[k] = -DBL_MAX;
+    }
+    for (size_t i = 0; i < s.verts.size(); i++) {
+      if (!s.boundary[i] || !s.owned[i])
+        continue;
+      for (int k = 0; k < 3; k++) {
+        lo[k] = std::min(lo[k], mb.x[k][i]);
+        hi[k] = std::max(hi[k], mb.x[k][i]);
+      }
+      bool moves = mb.disp[0][i] != 0 || mb.disp[1][i] != 0 || mb.disp[2][i] != 0;
+      if (!moves && numFixed++ % sampleStride)
+        continue;
+      for (int k = 0; k < 3; k++)
+        local.push_back(mb.x[k][i]);
+      for (int k = 0; k < 3; k++)
+        local.push_back(mb.disp[k][i]);
+    }
+    PCU_Min_Doubles(lo, 3);
+    PCU_Max_Doubles(hi, 3);
+    MPI_Comm comm = PCU_Get_Comm();
+    int peers = PCU_Comm_Peers();
+    bool root = !PCU_Comm_Self();
+    int count = (int)local.size();
+    std::vector<int> counts(peers), displs(peers + 1, 0);
+    MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, comm);
+    if (root)
+      for (int r = 0; r < peers; r++)
+        displs[r+1] = displs[r] + counts[r];
+    std::vector<double> all(displs[peers]);
+    MPI_Gatherv(local.empty() ? 0 : &local[0], count, MPI_DOUBLE,
+        all.empty() ? 0 : &all[0], &counts[0], &displs[0], MPI_DOUBLE, 0, comm);
+    size_t n = all.size() / 6;
+    for (int k = 0; k < 3; k++) {
+      x[k].resize(n);
+      d[k].resize(n);
+    }
+    for (size_t i = 0; i < n; i++)
+      for (int k = 0; k < 3; k++) {
+        x[k][i] = all[6*i + k];
+        d[k][i] = all[6*i + 3 + k];
+      }
+  }
+
+  /* the centers and weights built on rank 0 to every rank */
+  static void broadcastRbf(rbfInterpolant& rbf) {
+    MPI_Comm comm = PCU_Get_Comm();
+    long n = (long)rbf.size();
+    MPI_Bcast(&n, 1, MPI_LONG, 0, comm);
+    MPI_Bcast(&rbf.radius, 1, MPI_DOUBLE, 0, comm);
+    std::vector<double> cw(6 * n);
+    if (!PCU_Comm_Self())
+      for (int k = 0; k < 3; k++) {
+        std::copy(rbf.c[k].begin(), rbf.c[k].end(), cw.begin() + k * n);
+        std::copy(rbf.w[k].begin(), rbf.w[k].end(), cw.begin() + (3 + k) * n);
+      }
+    if (n)
+      MPI_Bcast(&cw[0], 6 * n, MPI_DOUBLE, 0, comm);
+    std::vector<double> c[3], w[3];
+    for (int k = 0; k < 3; k++) {
+      c[k].assign(cw.begin() + k * n, cw.begin() + (k + 1) * n);
+      w[k].assign(cw.begin() + (3 + k) * n, cw.begin() + (4 + k) * n);
+    }
+    fillGrid(rbf, c, w);
+  }
+
+  bool runRbfMover(ph::Input& in, apf::Mesh2* m) {
+    control const& c = getControl();
+    double t0 = PCU_Time();
+    moverSystem& s = getMoverSystem(m);
+    motionBuffer& mb = getMotionBuffer();
+    bool rigid = gatherBoundaryMotion(in, m, s, mb);
+    std::vector<double> bx[3], bd[3];
+    double lo[3], hi[3];
+    gatherBoundaryPoints(s, mb, std::max(1, c.rbfFixedStride), bx, bd, lo, hi);
+    /* support radius relative to the boundary bounding box */
+    double diag2 = 0;
+    for (int k = 0; k < 3; k++)
+      if (hi[k] >= lo[k])
+        diag2 += (hi[k] - lo[k]) * (hi[k] - lo[k]);
+    rbfInterpolant rbf;
+    rbf.radius = c.rbfSupport * sqrt(diag2);
+    if (!PCU_Comm_Self())
+      buildRbfInterpolant(bx, bd, rbf.radius, c.rbfTolerance, c.rbfMaxCenters, rbf);
+    broadcastRbf(rbf);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "rbf mover: %lu centers from %lu sampled boundary points in %f seconds\n",
+        (unsigned long)rbf.size(), (unsigned long)bx[0].size(), t1 - t0);
+    /* interior vertices within the influence radius only, the boundary
+       keeps its prescribed motion and the far field stays */
+    std::vector<char> far;
+    findFarVertices(m, getRigidBodyMotions(in), mb, far);
+    std::vector<int> interior;
+    for (size_t i = 0; i < s.verts.size(); i++) {
+      if (s.boundary[i])
+        continue;
+      if (!far.empty() && far[i]) {
+        for (int k = 0; k < 3; k++)
+          mb.disp[k][i] = 0;
+        continue;
+      }
+      interior.push_back((int)i);
+    }
+    size_t n = interior.size();
+    std::vector<double> ix[3], id[3];
+    for (int k = 0; k < 3; k++) {
+      ix[k].resize(n);
+      id[k].resize(n);
+      for (size_t i = 0; i < n; i++)
+        ix[k][i] = mb.x[k][interior[i]];
+    }
+    if (n) {
+      const double* const xp[3] = {&ix[0][0], &ix[1][0], &ix[2][0]};
+      double* const dp[3] = {&id[0][0], &id[1][0], &id[2][0]};
+      evalRbf(rbf, n, xp, dp);
+    }
+    for (size_t i = 0; i < n; i++)
+      for (int k = 0; k < 3; k++)
+        mb.disp[k][interior[i]] = id[k][i];
+    for (size_t i = 0; i < mb.size(); i++)
+      for (int k = 0; k < 3; k++)
+        mb.target[k][i] = mb.x[k][i] + mb.disp[k][i];
+    scatterCoordinates(m, mb);
+    if (rigid)
+      resetRigidBodyTotals(in);
+    double t2 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "rbf mover: interior evaluated in %f seconds\n", t2 - t1);
+    return true;
+  }
+
+}
@@ -0,0 +1,43 @@
+#ifndef PC_RBFMOVER_H
+#define PC_RBFMOVER_H
+
+#include <chef.h>
+#include <apf.h>
+#include <apfMesh2.h>
+#include <vector>
+
+namespace pc {
+
+  /* Wendland C2 interpolant of a vector field; centers and weights are
+     sorted by the cells of a uniform grid with the support radius as
+     spacing, so an evaluation only visits the 27 cells around a point */
+  struct rbfInterpolant {
+    double radius;
+    double h;                   // cell size, at least the radius
+    double lo[3];
+    int dims[3];
+    std::vector<int> cellStart; // centers of cell i: [cellStart[i], cellStart[i+1])
+    std::vector<double> c[3];   // center coordinates
+    std::vector<double> w[3];   // weights per component
+    size_t size() const { return c[0].size(); }
+  };
+
+  /* greedy center selection on the points x with values d: start from
+     the largest value and add the worst interpolated points until every
+     point is within tol * max|d| or maxCenters is reached; runRbfMover
+     selects on rank 0 and broadcasts the centers and weights */
+  void buildRbfInterpolant(std::vector<double> const* x, std::vector<double> const* d,
+      double radius, double tol, int maxCenters, rbfInterpolant& rbf);
+
+  /* threaded; out[k][i] = rbf(x[.][i]) for i in [0,n) */
+  void evalRbf(rbfInterpolant const& rbf, size_t n,
+      const double* const x[3], double* const out[3]);
+
+  /* collective; boundary motion as for the elastic mover, interior motion
+     interpolated from the moving boundary points of all parts and one in
+     pcRbfFixedStride of the points that stay */
+  bool runRbfMover(ph::Input& in, apf::Mesh2* m);
+
+}
+
+#endif
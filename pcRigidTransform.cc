@@ -0,0 +1,433 @@
+#include "pcRigidTransform.h"
+#include "pcClassification.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcThreads.h"
+#include "pcTimeDepMesh.h"
+#include <PCU.h>
+#include <phastaChef.h>
+#include <gmi.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <list>
+#include <map>
+
+namespace pc {
+
+  rigidTransform makeRigidTransform(rigidBodyMotion const& rbm) {
+    rigidTransform T;
+    for (int i = 0; i < 3; i++) {
+      T.p[i] = rbm.rotpt[i];
+      T.t[i] = rbm.trans[i];
+      for (int j = 0; j < 3; j++)
+        T.R[i][j] = (i == j) ? 1.0 : 0.0;
+    }
+    T.s = (rbm.scale > 0) ? rbm.scale : 1.0;
+    double a[3] = {rbm.rotaxis[0], rbm.rotaxis[1], rbm.rotaxis[2]};
+    double len = sqrt(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]);
+    bool rotates = (rbm.rotang != 0 && len > 0);
+    if (rotates) {
+      /* Rodrigues: R = cI + (1-c)aa^T + s[a]x */
+      for (int i = 0; i < 3; i++)
+        a[i] /= len;
+      double th = rbm.rotang * M_PI / 180.0;
+      double c = cos(th), s = sin(th);
+      double K[3][3] = {{0, -a[2], a[1]}, {a[2], 0, -a[0]}, {-a[1], a[0], 0}};
+      for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+          T.R[i][j] = ((i == j) ? c : 0.0) + (1 - c) * a[i] * a[j] + s * K[i][j];
+    }
+    bool translates = (T.t[0] != 0 || T.t[1] != 0 || T.t[2] != 0);
+    if (T.s != 1.0)
+      T.kind = TRANSFORM_GENERAL;
+    else if (rotates)
+      T.kind = TRANSFORM_ROTATION;
+    else if (translates)
+      T.kind = TRANSFORM_TRANSLATION;
+    else
+      T.kind = TRANSFORM_IDENTITY;
+    return T;
+  }
+
+  rigidBodyMotion toRigidBodyMotion(ph::rigidBodyMotion const& rbm) {
+    rigidBodyMotion r(rbm.tag, rbm.rotang, rbm.scale);
+    r.set_trans(rbm.trans[0], rbm.trans[1], rbm.trans[2]);
+    r.set_rotaxis(rbm.rotaxis[0], rbm.rotaxis[1], rbm.rotaxis[2]);
+    r.set_rotpt(rbm.rotpt[0], rbm.rotpt[1], rbm.rotpt[2]);
+    return r;
+  }
+
+  /* one specialization per transform kind keeps the inner loops free of
+     branches and dead terms so the compiler vectorizes them. The x, y
+     and z arrays never overlap each other; in place kernels read and
+     write through the same restrict pointer, the others assume out does
+     not overlap in */
+  template <int Kind, bool InPlace>
+  struct transformKernel;
+
+  template <bool InPlace>
+  struct transformKernel<TRANSFORM_TRANSLATION, InPlace> {
+    static void apply(rigidTransform const& T, size_t n,
+        const double* const in[3], double* const out[3]) {
+      for (int d = 0; d < 3; d++) {
+        double* __restrict__ y = out[d];
+        const double t = T.t[d];
+        if (InPlace) {
+          for (size_t i = 0; i < n; i++)
+            y[i] += t;
+        }
+        else {
+          const double* __restrict__ x = in[d];
+          for (size_t i = 0; i < n; i++)
+            y[i] = x[i] + t;
+        }
+      }
+    }
+  };
+
+  template <int Kind, bool InPlace>
+  struct transformKernel {
+    static void apply(rigidTransform const& T, size_t n,
+        const double* const in[3], double* const out[3]) {
+      double* __restrict__ ox = out[0];
+      double* __restrict__ oy = out[1];
+      double* __restrict__ oz = out[2];
+      const double* __restrict__ x = InPlace ? ox : in[0];
+      const double* __restrict__ y = InPlace ? oy : in[1];
+      const double* __restrict__ z = InPlace ? oz : in[2];
+      const double s = (Kind == TRANSFORM_GENERAL) ? T.s : 1.0;
+      const double r00 = s*T.R[0][0], r01 = s*T.R[0][1], r02 = s*T.R[0][2];
+      const double r10 = s*T.R[1][0], r11 = s*T.R[1][1], r12 = s*T.R[1][2];
+      const double r20 = s*T.R[2][0], r21 = s*T.R[2][1], r22 = s*T.R[2][2];
+      const double px = T.p[0], py = T.p[1], pz = T.p[2];
+      const double cx = px + T.t[0], cy = py + T.t[1], cz = pz + T.t[2];
+      for (size_t i = 0; i < n; i++) {
+        const double dx = x[i] - px, dy = y[i] - py, dz = z[i] - pz;
+        const double nx = r00*dx + r01*dy + r02*dz + cx;
+        const double ny = r10*dx + r11*dy + r12*dz + cy;
+        const double nz = r20*dx + r21*dy + r22*dz + cz;
+        ox[i] = nx;
+        oy[i] = ny;
+        oz[i] = nz;
+      }
+    }
+  };
+
+  template <int Kind>
+  static void runKernel(rigidTransform const& T, size_t n,
+      const double* const in[3], double* const out[3], bool inPlace) {
+    if (inPlace)
+      transformKernel<Kind, true>::apply(T, n, in, out);
+    else
+      transformKernel<Kind, false>::apply(T, n, in, out);
+  }
+
+  static bool overlaps(const double* a, double* b, size_t n) {
+    return a < b + n && b < a + n;
+  }
+
+  void applyRigidTransform(rigidTransform const& T, size_t n,
+      const double* const in[3], double* const out[3]) {
+    if (!n)
+      return;
+    bool inPlace = true;
+    bool disjoint = true;
+    for (int d = 0; d < 3; d++) {
+      inPlace = inPlace && in[d] == out[d];
+      for (int e = 0; e < 3; e++)
+        disjoint = disjoint && !overlaps(in[e], out[d], n);
+    }
+    assert(inPlace || disjoint);
+    switch (T.kind) {
+      case TRANSFORM_IDENTITY:
+        if (!inPlace)
+          for (int d = 0; d < 3; d++)
+            std::copy(in[d], in[d] + n, out[d]);
+        break;
+      case TRANSFORM_TRANSLATION:
+        runKernel<TRANSFORM_TRANSLATION>(T, n, in, out, inPlace);
+        break;
+      case TRANSFORM_ROTATION:
+        runKernel<TRANSFORM_ROTATION>(T, n, in, out, inPlace);
+        break;
+      default:
+        runKernel<TRANSFORM_GENERAL>(T, n, in, out, inPlace);
+    }
+  }
+
+  static int findRigidBody(gmi_model* g, gmi_ent* e,
+      std::vector<gmi_ent*> const& bodies) {
+    for (size_t i = 0; i < bodies.size(); i++)
+      if (e == bodies[i] || gmi_is_in_closure_of(g, e, bodies[i]))
+        return (int)i;
+    return -1;
+  }
+
+  static void buildRigidBodyVertices(apf::Mesh* m, std::vector<int> const& tags,
+      rigidBodyVertices& rv) {
+    rv.epoch = getTopologyEpoch();
+    rv.mesh = m;
+    rv.tags = tags;
+    gmi_model* g = m->getModel();
+    std::vector<gmi_ent*> bodies(tags.size());
+    for (size_t i = 0; i < tags.size(); i++) {
+      bodies[i] = gmi_find(g, 3, tags[i]);
+      assert(bodies[i]);
+    }
+    /* one closure query per model entity, then bucket the vertices */
+    std::map<gmi_ent*, int> bodyOf;
+    std::vector<std::vector<apf::MeshEntity*> > buckets(tags.size());
+    apf::MeshEntity* v;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (v = m->iterate(itr)) ) {
+      gmi_ent* e = reinterpret_cast<gmi_ent*>(m->toModel(v));
+      std::map<gmi_ent*, int>::iterator it = bodyOf.find(e);
+      if (it == bodyOf.end())
+        it = bodyOf.insert(std::make_pair(e, findRigidBody(g, e, bodies))).first;
+      if (it->second >= 0)
+        buckets[it->second].push_back(v);
+    }
+    m->end(itr);
+    rv.verts.clear();
+    rv.offset.assign(1, 0);
+    for (size_t i = 0; i < buckets.size(); i++) {
+      rv.verts.insert(rv.verts.end(), buckets[i].begin(), buckets[i].end());
+      rv.offset.push_back(rv.verts.size());
+    }
+  }
+
+  rigidBodyVertices& getRigidBodyVertices(apf::Mesh* m, std::vector<int> const& tags) {
+    static rigidBodyVertices rv;
+    if (rv.epoch != getTopologyEpoch() || rv.mesh != m || rv.tags != tags)
+      buildRigidBodyVertices(m, tags, rv);
+    return rv;
+  }
+
+  void moveRigidBodies(apf::Mesh2* m, std::vector<rigidBodyMotion> const& rbms) {
+    std::vector<int> tags(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++)
+      tags[i] = rbms[i].tag;
+    rigidBodyVertices& rv = getRigidBodyVertices(m, tags);
+    size_t n = rv.verts.size();
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "rigid body vertices moved", (long)n);
+    if (!n)
+      return;
+    std::vector<double> x[3];
+    for (int d = 0; d < 3; d++)
+      x[d].resize(n);
+    apf::Vector3 p;
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(rv.verts[i], 0, p);
+      for (int d = 0; d < 3; d++)
+        x[d][i] = p[d];
+    }
+    for (size_t b = 0; b < rbms.size(); b++) {
+      size_t first = rv.offset[b];
+      if (first == rv.offset[b+1])
+        continue;
+      double* const xb[3] = {&x[0][0] + first, &x[1][0] + first, &x[2][0] + first};
+      applyRigidTransform(makeRigidTransform(rbms[b]), rv.offset[b+1] - first, xb, xb);
+    }
+    for (size_t i = 0; i < n; i++) {
+      for (int d = 0; d < 3; d++)
+        p[d] = x[d][i];
+      m->setPoint(rv.verts[i], 0, p);
+    }
+  }
+
+  bool hasRigidBodyMotions(ph::Input& in) {
+    return in.nRigidBody > 0 || !getMotionSchedule().empty();
+  }
+
+  std::vector<ph::rigidBodyMotion> getStepRigidBodyMotions(ph::Input& in) {
+    std::vector<ph::rigidBodyMotion> ph_rbms;
+    if (in.nRigidBody > 0) {
+      core_get_rbms(ph_rbms);
+      return ph_rbms;
+    }
+    motionSchedule const& s = getMotionSchedule();
+    if (s.empty())
+      return ph_rbms;
+    meshMotion mm = getTDMeshMotion(s, (double)in.timeStepNumber);
+    ph_rbms.resize(mm.rigidBodyMotions.size());
+    std::list<rigidBodyMotion>::const_iterator it = mm.rigidBodyMotions.begin();
+    for (size_t i = 0; i < ph_rbms.size(); i++, it++) {
+      rigidBodyMotion const& r = *it;
+      ph::rigidBodyMotion& p = ph_rbms[i];
+      p.tag = r.tag;
+      for (int d = 0; d < 3; d++) {
+        p.trans[d] = r.trans[d];
+        p.rotaxis[d] = r.rotaxis[d];
+        p.rotpt[d] = r.rotpt[d];
+      }
+      p.rotang = r.rotang;
+      p.scale = r.scale;
+    }
+    return ph_rbms;
+  }
+
+  std::vector<rigidBodyMotion> getRigidBodyMotions(ph::Input& in) {
+    std::vector<ph::rigidBodyMotion> ph_rbms = getStepRigidBodyMotions(in);
+    std::vector<rigidBodyMotion> rbms(ph_rbms.size());
+    for (size_t i = 0; i < ph_rbms.size(); i++)
+      rbms[i] = toRigidBodyMotion(ph_rbms[i]);
+    return rbms;
+  }
+
+  void transformRigidBodyTargets(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      std::unordered_map<apf::MeshEntity*, int> const& index, motionBuffer& mb) {
+    std::vector<int> tags(rbms.size());
+    for (size_t i = 0; i < rbms.size(); i++)
+      tags[i] = rbms[i].tag;
+    rigidBodyVertices& rv = getRigidBodyVertices(m, tags);
+    std::vector<int> ids;
+    std::vector<double> x[3];
+    for (size_t b = 0; b < rbms.size(); b++) {
+      size_t n = rv.offset[b+1] - rv.offset[b];
+      if (!n)
+        continue;
+      ids.resize(n);
+      for (int d = 0; d < 3; d++)
+        x[d].resize(n);
+      for (size_t i = 0; i < n; i++) {
+        std::unordered_map<apf::MeshEntity*, int>::const_iterator it =
+          index.find(rv.verts[rv.offset[b] + i]);
+        assert(it != index.end());
+        ids[i] = it->second;
+        for (int d = 0; d < 3; d++)
+          x[d][i] = mb.x[d][ids[i]];
+      }
+      double* const xb[3] = {&x[0][0], &x[1][0], &x[2][0]};
+      applyRigidTransform(makeRigidTransform(rbms[b]), n, xb, xb);
+      for (size_t i = 0; i < n; i++)
+        for (int d = 0; d < 3; d++)
+          mb.target[d][ids[i]] = x[d][i];
+    }
+  }
+
+  static bool allRegionsRigid(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms) {
+    gmi_model* g = m->getModel();
+    gmi_iter* it = gmi_begin(g, 3);
+    gmi_ent* r;
+    bool all = true;
+    while (all && (r = gmi_next(g, it))) {
+      int tag = gmi_tag(g, r);
+      all = false;
+      for (size_t i = 0; i < rbms.size() && !all; i++)
+        all = (rbms[i].tag == tag);
+    }
+    gmi_end(g, it);
+    return all && !rbms.empty();
+  }
+
+  int findRigidMotion(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      rigidBodyMotion& whole) {
+    if (allRegionsRigid(m, rbms))
+      return MOTION_BODIES;
+    /* separate bodies in a deforming domain do not move as one */
+    if (rbms.size() > 1)
+      return MOTION_GENERAL;
+    apf::Field* f = m->findField("motion_coords");
+    if (!f)
+      return MOTION_GENERAL;
+    motionBuffer mb;
+    apf::MeshEntity* v;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (v = m->iterate(itr)) )
+      if (m->isOwned(v))
+        mb.verts.push_back(v);
+    m->end(itr);
+    gatherMotion(m, f, mb);
+    size_t n = mb.size();
+    /* candidates: every body transform, then the midrange translation */
+    size_t nc = rbms.size() + 1;
+    std::vector<double> lo(9, DBL_MAX), hi(9, -DBL_MAX); // extent, displacement
+    for (int d = 0; d < 3; d++)
+      for (size_t i = 0; i < n; i++) {
+        lo[d] = std::min(lo[d], mb.x[d][i]);
+        hi[d] = std::max(hi[d], mb.x[d][i]);
+        lo[3+d] = std::min(lo[3+d], mb.disp[d][i]);
+        hi[3+d] = std::max(hi[3+d], mb.disp[d][i]);
+      }
+    for (int d = 0; d < 6; d++)
+      lo[d] = -lo[d];
+    PCU_Max_Doubles(&lo[0], 6);
+    PCU_Max_Doubles(&hi[0], 6);
+    double extent = 0;
+    for (int d = 0; d < 3; d++)
+      extent = std::max(extent, hi[d] + lo[d]);
+    double tol = getControl().rigidTolerance * extent;
+    std::vector<double> err(nc, 0.0);
+    /* transformed in chunks, so one vertex off the transform ends the
+       test early */
+    const size_t chunk = 1024;
+    std::vector<double> y[3];
+    for (int d = 0; d < 3; d++)
+      y[d].resize(std::min(chunk, n));
+    for (size_t b = 0; b < rbms.size(); b++) {
+      rigidTransform T = makeRigidTransform(rbms[b]);
+      double e = 0;
+      for (size_t c = 0; c < n && e <= tol; c += chunk) {
+        size_t len = std::min(chunk, n - c);
+        const double* const xp[3] = {&mb.x[0][c], &mb.x[1][c], &mb.x[2][c]};
+        double* const yp[3] = {&y[0][0], &y[1][0], &y[2][0]};
+        applyRigidTransform(T, len, xp, yp);
+        for (size_t i = 0; i < len; i++)
+          for (int d = 0; d < 3; d++)
+            e = std::max(e, fabs(y[d][i] - mb.target[d][c + i]));
+      }
+      err[b] = e;
+    }
+    PCU_Max_Doubles(&err[0], (int)nc);
+    double t[3];
+    for (int d = 0; d < 3; d++) {
+      t[d] = 0.5 * (hi[3+d] - lo[3+d]);
+      err[nc-1] = std::max(err[nc-1], 0.5 * (hi[3+d] + lo[3+d]));
+    }
+    for (size_t k = 0; k < nc; k++) {
+      if (err[k] > tol)
+        continue;
+      if (k < rbms.size()) {
+        whole = rbms[k];
+      }
+      else {
+        whole = rigidBodyMotion();
+        whole.set_trans(t[0], t[1], t[2]);
+      }
+      return MOTION_WHOLE;
+    }
+    return MOTION_GENERAL;
+  }
+
+  void moveWholeMesh(apf::Mesh2* m, rigidTransform const& T) {
+    std::vector<apf::MeshEntity*> verts;
+    verts.reserve(m->count(0));
+    apf::MeshEntity* v;
+    apf::MeshIterator* itr = m->begin(0);
+    while( (v = m->iterate(itr)) )
+      verts.push_back(v);
+    m->end(itr);
+    size_t n = verts.size();
+    std::vector<double> x[3];
+    for (int d = 0; d < 3; d++)
+      x[d].resize(n);
+    apf::Vector3 p;
+    for (size_t i = 0; i < n; i++) {
+      m->getPoint(verts[i], 0, p);
+      for (int d = 0; d < 3; d++)
+        x[d][i] = p[d];
+    }
+    parallelFor(n, [&](size_t b, size_t e, int) {
+      double* const xb[3] = {&x[0][0] + b, &x[1][0] + b, &x[2][0] + b};
+      applyRigidTransform(T, e - b, xb, xb);
+    });
+    for (size_t i = 0; i < n; i++) {
+      for (int d = 0; d < 3; d++)
+        p[d] = x[d][i];
+      m->setPoint(verts[i], 0, p);
+    }
+  }
+
+}
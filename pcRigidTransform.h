@@ -0,0 +1,94 @@
+#ifndef PC_RIGIDTRANSFORM_H
+#define PC_RIGIDTRANSFORM_H
+
+#include "pcUpdateMesh.h"
+#include "pcMotionBuffer.h"
+#include <apf.h>
+#include <apfMesh2.h>
+#include <unordered_map>
+#include <vector>
+
+namespace pc {
+
+  enum {
+    TRANSFORM_IDENTITY,
+    TRANSFORM_TRANSLATION, // x + t
+    TRANSFORM_ROTATION,    // R(x - p) + p + t
+    TRANSFORM_GENERAL      // sR(x - p) + p + t
+  };
+
+  /* rigidBodyMotion in the form applied by the kernels; like
+     MeshMover_setTransform the angle is in degrees and a scale <= 0
+     means no scaling */
+  struct rigidTransform {
+    int kind;
+    double R[3][3];
+    double p[3];
+    double t[3];
+    double s;
+  };
+
+  rigidTransform makeRigidTransform(rigidBodyMotion const& rbm);
+
+  rigidBodyMotion toRigidBodyMotion(ph::rigidBodyMotion const& rbm);
+
+  /* out = T(in) on structure-of-arrays coordinates of n points; out may
+     be in or an array disjoint from it. The three components of in, and
+     of out, must not overlap each other */
+  void applyRigidTransform(rigidTransform const& T, size_t n,
+      const double* const in[3], double* const out[3]);
+
+  /* vertices in the closure of each rigid body region, grouped by body:
+     body i owns verts[offset[i]] .. verts[offset[i+1]-1] */
+  struct rigidBodyVertices {
+    rigidBodyVertices(): epoch(-1), mesh(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    std::vector<int> tags;
+    std::vector<apf::MeshEntity*> verts;
+    std::vector<size_t> offset;
+  };
+
+  /* cached per topology epoch, mesh and set of body tags */
+  rigidBodyVertices& getRigidBodyVertices(apf::Mesh* m, std::vector<int> const& tags);
+
+  /* move the rigid body vertices of m, everything else is left in place */
+  void moveRigidBodies(apf::Mesh2* m, std::vector<rigidBodyMotion> const& rbms);
+
+  /* whether a step has rigid body transforms, from phasta or from the
+     pcMotionSchedule */
+  bool hasRigidBodyMotions(ph::Input& in);
+
+  /* the rigid body transforms phasta accumulated since the last reset;
+     with nRigidBody 0 those of the pcMotionSchedule at the time step
+     number, empty if neither is given */
+  std::vector<ph::rigidBodyMotion> getStepRigidBodyMotions(ph::Input& in);
+
+  /* getStepRigidBodyMotions in the form of the pc:: movers */
+  std::vector<rigidBodyMotion> getRigidBodyMotions(ph::Input& in);
+
+  /* how the motion of a step moves the mesh, see findRigidMotion */
+  enum {
+    MOTION_GENERAL, // the mover is needed
+    MOTION_BODIES,  // every model region is one of the rigid bodies
+    MOTION_WHOLE    // one rigid transform moves every vertex
+  };
+
+  /* collective; MOTION_BODIES if every model region is a body of rbms,
+     else, with at most one body, MOTION_WHOLE with the transform in whole
+     if motion_coords moves every vertex by the body transform or by one
+     translation, within pcRigidTolerance of the mesh extent */
+  int findRigidMotion(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      rigidBodyMotion& whole);
+
+  /* move every vertex of m by T; all copies get the same move */
+  void moveWholeMesh(apf::Mesh2* m, rigidTransform const& T);
+
+  /* set mb.target of the rigid body vertices to their transformed mb.x;
+     index maps a vertex to its position in mb */
+  void transformRigidBodyTargets(apf::Mesh* m, std::vector<rigidBodyMotion> const& rbms,
+      std::unordered_map<apf::MeshEntity*, int> const& index, motionBuffer& mb);
+
+}
+
+#endif
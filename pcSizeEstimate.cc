@@ -0,0 +1,155 @@
+#include "pcSizeEstimate.h"
+#include "pcAdapter.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include "pcQuality.h"
+#include "pcThreads.h"
+#include <SimAdvMeshing.h>
+#include <PCU.h>
+#include <gmi.h>
+#include <algorithm>
+#include <cassert>
+
+namespace pc {
+
+  /* a regular tet of edge a has cur_size sqrt(2) a and volume
+     a^3/(6 sqrt(2)), so an element of cur_size h fills h^3/24 */
+  static const double curSizeCubesPerVolume = 24.0;
+
+  static void buildCurrentSizes(apf::Mesh2* m, currentSizes& c) {
+    c.bl.clear();
+    c.region.clear();
+    c.vertStart.assign(1, 0);
+    c.verts.clear();
+    c.regionTags.clear();
+
+    gmi_model* g = m->getModel();
+    gmi_iter* git = gmi_begin(g, 3);
+    gmi_ent* r;
+    while ((r = gmi_next(g, git)))
+      c.regionTags.push_back(gmi_tag(g, r));
+    gmi_end(g, git);
+    std::sort(c.regionTags.begin(), c.regionTags.end());
+
+    apf::MeshTag* id = m->createIntTag("size_id", 1);
+    int n = 0;
+    apf::MeshEntity* v;
+    apf::MeshIterator* vit = m->begin(0);
+    while ((v = m->iterate(vit))) {
+      m->setIntTag(v, id, &n);
+      n++;
+    }
+    m->end(vit);
+    c.numVerts = n;
+
+    getCurrentSizeSources(m, c.elms, c.from);
+    apf::Downward vs;
+    for (size_t i = 0; i < c.elms.size(); i++) {
+      apf::MeshEntity* e = c.elms[i];
+      c.bl.push_back(EN_isBLEntity(reinterpret_cast<pEntity>(e)) ? 1 : 0);
+      int tag = m->getModelTag(m->toModel(e));
+      std::vector<int>::iterator it =
+          std::lower_bound(c.regionTags.begin(), c.regionTags.end(), tag);
+      assert(it != c.regionTags.end() && *it == tag);
+      c.region.push_back(it - c.regionTags.begin());
+      int nv = m->getDownward(e, 0, vs);
+      for (int j = 0; j < nv; j++) {
+        int k;
+        m->getIntTag(vs[j], id, &k);
+        c.verts.push_back(k);
+      }
+      c.vertStart.push_back((int)c.verts.size());
+    }
+
+    vit = m->begin(0);
+    while ((v = m->iterate(vit)))
+      m->removeTag(v, id);
+    m->end(vit);
+    m->destroyTag(id);
+  }
+
+  /* the sizes and volumes from the current coordinates */
+  static void measureCurrentSizes(apf::Mesh2* m, currentSizes& c) {
+    elementCoords ec;
+    extractElementCoords(m, ec);
+    assert(ec.size() == c.elms.size());
+    c.h.resize(ec.size());
+    c.vol.resize(ec.size());
+    for (size_t i = 0; i < ec.size(); i++) {
+      c.h[i] = measureCurrentSize(m, c.elms[i], c.from[i]);
+      c.vol[i] = elementTotalVolume(ec, i);
+      if (c.vol[i] == 0)
+        c.vol[i] = c.h[i]*c.h[i]*c.h[i] / curSizeCubesPerVolume;
+    }
+  }
+
+  currentSizes& getCurrentSizes(apf::Mesh2* m) {
+    static currentSizes c;
+    double t0 = PCU_Time();
+    if (c.mesh != m || c.epoch != getTopologyEpoch()) {
+      buildCurrentSizes(m, c);
+      c.mesh = m;
+      c.epoch = getTopologyEpoch();
+    }
+    measureCurrentSizes(m, c);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_DEBUG, "current element sizes measured in %f seconds\n", t1 - t0);
+    return c;
+  }
+
+  sizeEstimate estimateAdaptedElements(currentSizes const& c,
+      std::vector<double> const (&h)[3]) {
+    assert(h[0].size() == c.numVerts);
+    size_t nr = c.regionTags.size();
+    std::vector<double> d3(c.numVerts), d2(c.numVerts);
+    for (size_t i = 0; i < c.numVerts; i++) {
+      d3[i] = 1.0 / (h[0][i] * h[1][i] * h[2][i]);
+      d2[i] = 1.0 / (h[0][i] * h[0][i]);
+    }
+    std::vector<double> partial(getNumThreads() * nr, 0.0);
+    parallelFor(c.h.size(), [&](size_t b, size_t e, int t) {
+      double* sum = &partial[t * nr];
+      for (size_t i = b; i < e; i++) {
+        double const* d = c.bl[i] ? &d2[0] : &d3[0];
+        double mean = 0.0;
+        for (int j = c.vertStart[i]; j < c.vertStart[i+1]; j++)
+          mean += d[c.verts[j]];
+        mean /= c.vertStart[i+1] - c.vertStart[i];
+        double vol = c.bl[i] ? c.h[i]*c.h[i] : curSizeCubesPerVolume * c.vol[i];
+        sum[c.region[i]] += vol * mean;
+      }
+    });
+    sizeEstimate est;
+    est.regions.assign(nr, 0.0);
+    for (size_t t = 0; t < partial.size(); t++)
+      est.regions[t % nr] += partial[t];
+    est.local = 0.0;
+    for (size_t r = 0; r < nr; r++)
+      est.local += est.regions[r];
+    est.total = PCU_Add_Double(est.local);
+    est.minPart = PCU_Min_Double(est.local);
+    est.maxPart = PCU_Max_Double(est.local);
+    if (nr)
+      PCU_Add_Doubles(&est.regions[0], nr);
+    return est;
+  }
+
+  void reportSizeEstimate(currentSizes const& c, sizeEstimate const& e) {
+    PC_LOG_ALL(PC_LOG_TRACE, "%ld elements, %f estimated\n", (long)c.h.size(), e.local);
+    if (!PC_LOG_ON(PC_LOG_DEBUG))
+      return;
+    size_t nr = c.regionTags.size();
+    std::vector<double> counts(nr, 0.0);
+    for (size_t i = 0; i < c.region.size(); i++)
+      counts[c.region[i]] += 1.0;
+    if (nr)
+      PCU_Add_Doubles(&counts[0], nr);
+    double mean = e.total / PCU_Comm_Peers();
+    PC_LOG(PC_LOG_DEBUG, "estimated elements per part: min %f max %f imbalance %f\n",
+        e.minPart, e.maxPart, mean > 0 ? e.maxPart / mean : 1.0);
+    for (size_t r = 0; r < nr; r++)
+      PC_LOG(PC_LOG_DEBUG, "model region %d: %.0f elements, %f estimated\n",
+          c.regionTags[r], counts[r], e.regions[r]);
+  }
+
+}
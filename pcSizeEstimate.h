@@ -0,0 +1,56 @@
+#ifndef PC_SIZE_ESTIMATE_H
+#define PC_SIZE_ESTIMATE_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <vector>
+
+namespace pc {
+
+  /* the current size of every element of a part, in iteration order,
+     with its vertices as local vertex ids (vertex iteration order) */
+  struct currentSizes {
+    currentSizes(): epoch(-1), mesh(0), numVerts(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    size_t numVerts;
+    std::vector<apf::MeshEntity*> elms;
+    std::vector<apf::MeshEntity*> from; // of getCurrentSizeSources
+    std::vector<double> h;        // the cur_size of attachCurrentSizeField
+    std::vector<double> vol;      // element volume, h^3/24 for types without a tet split
+    std::vector<char> bl;         // boundary layer element
+    std::vector<int> region;      // index into regionTags
+    std::vector<int> vertStart;   // vertices of element e: verts[vertStart[e]] ..
+    std::vector<int> verts;
+    std::vector<int> regionTags;  // model regions, sorted, the same on all parts
+  };
+
+  /* returns the cached sizes; the elements, their vertices and size
+     sources are rebuilt when the mesh or its topology epoch changes, the
+     sizes and volumes are measured again on every call since the mover
+     changes the coordinates within an epoch */
+  currentSizes& getCurrentSizes(apf::Mesh2* m);
+
+  struct sizeEstimate {
+    double local;   // elements of this part after adapt
+    double total;   // over all parts
+    double minPart;
+    double maxPart;
+    std::vector<double> regions; // per model region, over all parts
+  };
+
+  /* collective; the number of elements after adapting to the principal
+     sizes h[0..2] at each local vertex. The metric density 1/(h0 h1 h2)
+     is interpolated linearly over an element, so its integral is the
+     vertex mean times the element volume, counted in elements of the
+     cur_size h, which fill h^3/24; BL elements only refine within their
+     layer, with density 1/h0^2 over an area of cur_size squared */
+  sizeEstimate estimateAdaptedElements(currentSizes const& c,
+      std::vector<double> const (&h)[3]);
+
+  /* collective; per part spread and per model region counts at debug */
+  void reportSizeEstimate(currentSizes const& c, sizeEstimate const& e);
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "pcSizePipeline.h"
+#include "pcLog.h"
+#include "pcSizeEstimate.h"
+#include "pcSmooth.h"
+#include "pcThreads.h"
+#include "apfSIM.h"
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace pc {
+
+  std::vector<int> parseSizeStages(std::string const& list) {
+    std::vector<int> stages;
+    std::istringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+      if (name == "bound") stages.push_back(SIZE_BOUND);
+      else if (name == "budget") stages.push_back(SIZE_BUDGET);
+      else if (name == "cfl") stages.push_back(SIZE_CFL);
+      else if (name == "gradation") stages.push_back(SIZE_GRADATION);
+      else if (!name.empty()) {
+        PC_LOG(PC_LOG_ERROR, "unknown size stage \"%s\" in pcSizeStages\n", name.c_str());
+        abort();
+      }
+    }
+    return stages;
+  }
+
+  /* one point-wise stage of a fused pass */
+  struct sizeOp {
+    int stage;
+    double value; // the upper bound or the scale
+  };
+
+  /* one sweep over the fields; the CFL floor is computed from the
+     solution on the first sweep that asks for it */
+  static void gatherSizes(apf::Mesh* m, apf::Field* sizes, apf::Field* ctcn,
+      sizeBuffer& b, ph::Input& in, double dt, bool withFloor) {
+    apf::Field* sol = 0;
+    if (withFloor) {
+      sol = m->findField("solution");
+      assert(sol);
+      b.floor.resize(b.size());
+    }
+    apf::NewArray<double> s(in.ensa_dof);
+    apf::Vector3 v_mag;
+    for (size_t i = 0; i < b.size(); i++) {
+      apf::MeshEntity* v = b.verts[i];
+      apf::getVector(sizes, v, 0, v_mag);
+      for (int d = 0; d < 3; d++)
+        b.h[d][i] = v_mag[d];
+      b.ctcn[i] = ctcn ? apf::getScalar(ctcn, v, 0) : 1.0;
+      if (!sol) continue;
+      apf::getComponents(sol, v, 0, &s[0]);
+      double u = sqrt(s[1]*s[1]+s[2]*s[2]+s[3]*s[3]);
+      double c = sqrt(1.4*8.3145*s[4]/0.029); // ideal air assumed here
+      b.floor[i] = std::max((u+c)*dt/in.simCFLUpperBound, in.simSizeLowerBound);
+    }
+  }
+
+  static void scatterSizes(apf::Field* sizes, apf::Field* ctcn, sizeBuffer const& b) {
+    for (size_t i = 0; i < b.size(); i++) {
+      apf::setVector(sizes, b.verts[i], 0, apf::Vector3(b.h[0][i], b.h[1][i], b.h[2][i]));
+      apf::setScalar(ctcn, b.verts[i], 0, b.ctcn[i]);
+    }
+  }
+
+  /* apply ops to every vertex in one pass and clear them; a CFL stage
+     raises the components below the floor, and ctcn of the vertex
+     becomes the last such ratio times its value before the stage */
+  static void runFused(sizeBuffer& b, std::vector<sizeOp>& ops,
+      double& maxCt, double& minCtH) {
+    if (ops.empty())
+      return;
+    std::vector<double> ct(getNumThreads(), 1.0);
+    std::vector<double> ch(getNumThreads(), 1.0e16);
+    parallelFor(b.size(), [&](size_t s, size_t e, int t) {
+      double maxC = 1.0, minH = 1.0e16;
+      for (size_t i = s; i < e; i++) {
+        double h[3] = {b.h[0][i], b.h[1][i], b.h[2][i]};
+        double f = b.ctcn[i];
+        for (size_t o = 0; o < ops.size(); o++) {
+          double val = ops[o].value;
+          if (ops[o].stage == SIZE_BOUND) {
+            for (int d = 0; d < 3; d++)
+              if (h[d] > val) h[d] = val;
+          }
+          else if (ops[o].stage == SIZE_BUDGET) {
+            for (int d = 0; d < 3; d++)
+              h[d] *= val;
+            f *= val;
+          }
+          else {
+            double hmin = b.floor[i];
+            double f0 = f;
+            for (int d = 0; d < 3; d++) {
+              if (h[d] < hmin) {
+                maxC = std::max(maxC, hmin/h[d]);
+                f = hmin/h[d]*f0;
+                minH = std::min(minH, hmin);
+                h[d] = hmin;
+              }
+            }
+          }
+        }
+        for (int d = 0; d < 3; d++)
+          b.h[d][i] = h[d];
+        b.ctcn[i] = f;
+      }
+      ct[t] = maxC;
+      ch[t] = minH;
+    });
+    for (size_t t = 0; t < ct.size(); t++) {
+      maxCt = std::max(maxCt, ct[t]);
+      minCtH = std::min(minCtH, ch[t]);
+    }
+    ops.clear();
+  }
+
+  void runSizePipeline(apf::Mesh2* m, ph::Input& in, phSolver::Input& inp,
+      std::vector<int> const& stages) {
+    double t0 = PCU_Time();
+    apf::Field* sizes = m->findField("sizes");
+    assert(sizes);
+    apf::Field* ctcn = apf::createSIMFieldOn(m, "ctcn_elm", apf::SCALAR);
+    bool withFloor = std::find(stages.begin(), stages.end(), SIZE_CFL) != stages.end();
+    double dt = withFloor ? (double)inp.GetValue("Time Step Size") : 0.0;
+
+    sizeBuffer b;
+    apf::MeshEntity* v;
+    apf::MeshIterator* vit = m->begin(0);
+    while ((v = m->iterate(vit)))
+      b.verts.push_back(v);
+    m->end(vit);
+    for (int d = 0; d < 3; d++)
+      b.h[d].resize(b.size());
+    b.ctcn.resize(b.size());
+    gatherSizes(m, sizes, 0, b, in, dt, withFloor);
+
+    /* stale: the fields changed after the buffer was read,
+       pending: the buffer changed after the fields were written */
+    bool stale = false;
+    bool pending = true;
+    std::vector<sizeOp> ops;
+    double maxCt = 1.0;
+    double minCtH = 1.0e16;
+    int numSweeps = 1;
+    for (size_t i = 0; i < stages.size(); i++) {
+      if (stages[i] != SIZE_GRADATION && stale) {
+        gatherSizes(m, sizes, ctcn, b, in, dt, false);
+        stale = false;
+        numSweeps++;
+      }
+      if (stages[i] == SIZE_BOUND) {
+        sizeOp op = {SIZE_BOUND, in.simSizeUpperBound};
+        ops.push_back(op);
+      }
+      else if (stages[i] == SIZE_CFL) {
+        sizeOp op = {SIZE_CFL, 0.0};
+        ops.push_back(op);
+      }
+      else if (stages[i] == SIZE_BUDGET) {
+        pending = pending || !ops.empty();
+        runFused(b, ops, maxCt, minCtH);
+        /* scale mesh if number of elements exceeds threshold */
+        currentSizes& cur = getCurrentSizes(m);
+        sizeEstimate est = estimateAdaptedElements(cur, b.h);
+        reportSizeEstimate(cur, est);
+        double N_est = est.total;
+        double cn = N_est / (double)in.simMaxAdaptMeshElements;
+        cn = (cn>1.0)?cbrt(cn):1.0;
+        PC_LOG(PC_LOG_INFO, "Estimated No. of Elm: %f and c_N = %f\n", N_est, cn);
+        sizeOp op = {SIZE_BUDGET, cn};
+        ops.push_back(op);
+      }
+      else {
+        pending = pending || !ops.empty();
+        runFused(b, ops, maxCt, minCtH);
+        if (pending) {
+          scatterSizes(sizes, ctcn, b);
+          numSweeps++;
+        }
+        pending = false;
+        addSmoother(m, in.gradingFactor);
+        stale = true;
+      }
+    }
+    pending = pending || !ops.empty();
+    runFused(b, ops, maxCt, minCtH);
+    if (pending) {
+      scatterSizes(sizes, ctcn, b);
+      numSweeps++;
+    }
+
+    if (withFloor) {
+      double maxCtAll  = PCU_Max_Double(maxCt);
+      double minCtHAll = PCU_Min_Double(minCtH);
+      PC_LOG(PC_LOG_INFO, "max time resource bound factor and min reached size: %f and %f\n",maxCtAll,minCtHAll);
+    }
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_DEBUG, "size field stages done with %d field sweeps in %f seconds\n",
+        numSweeps, t1 - t0);
+  }
+
+}
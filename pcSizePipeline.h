@@ -0,0 +1,44 @@
+#ifndef PC_SIZE_PIPELINE_H
+#define PC_SIZE_PIPELINE_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <chef.h>
+#include <phasta.h>
+#include <string>
+#include <vector>
+
+namespace pc {
+
+  enum {
+    SIZE_BOUND,     // clamp to simSizeUpperBound
+    SIZE_BUDGET,    // scale up to simMaxAdaptMeshElements
+    SIZE_CFL,       // floor from simCFLUpperBound and the time step
+    SIZE_GRADATION  // the edge smoother of pcSmooth
+  };
+
+  /* the stages of a comma separated pcSizeStages list, in order */
+  std::vector<int> parseSizeStages(std::string const& list);
+
+  /* structure-of-arrays copy of the sizes and ctcn_elm fields,
+     indexed by local vertex id (position in verts) */
+  struct sizeBuffer {
+    std::vector<apf::MeshEntity*> verts;
+    std::vector<double> h[3];
+    std::vector<double> ctcn;
+    std::vector<double> floor; // CFL size floor, filled if a stage needs it
+    size_t size() const { return verts.size(); }
+  };
+
+  /* runs the stages on the "sizes" field and creates "ctcn_elm" with the
+     time resource factors. The field is read once, consecutive
+     point-wise stages run fused in one threaded pass over the buffer and
+     the fields are written once, before a gradation stage and at the
+     end. A budget stage estimates the adapted mesh from the buffer with
+     estimateAdaptedElements */
+  void runSizePipeline(apf::Mesh2* m, ph::Input& in, phSolver::Input& inp,
+      std::vector<int> const& stages);
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "pcSmooth.h"
+#include "pcLog.h"
 #include <MeshSimAdapt.h>
 #include <SimUtil.h>
 #include <SimPartitionedMesh.h>
@@ -166,8 +167,7 @@ void addSmoother(apf::Mesh2* m, double gradingFactor) {
 
 void meshGradation(apf::Mesh2* m, double gradingFactor)
 {
-  if(!PCU_Comm_Self())
-    std::cout<<"Starting grading\n";
+  PC_LOG(PC_LOG_INFO, "Starting grading\n");
   apf::MeshEntity* edge;
   apf::Adjacent edgAdjVert;
   apf::Adjacent vertAdjEdg;
@@ -190,8 +190,7 @@ void meshGradation(apf::Mesh2* m, double gradingFactor)
     needsParallel = serialGradation(m,markedEdges,gradingFactor);
 
     PCU_Add_Ints(&needsParallel,1);
-    if(!PCU_Comm_Self())
-      std::cerr<<"Sending size info for gradation"<<std::endl;
+    PC_LOG(PC_LOG_DEBUG, "Sending size info for gradation\n");
     PCU_Comm_Send();
 
     apf::MeshEntity* ent;
@@ -211,7 +210,7 @@ void meshGradation(apf::Mesh2* m, double gradingFactor)
       PCU_COMM_UNPACK(receivedSize);
 
       if(!m->isOwned(ent)){
-        std::cout<<"THERE WAS AN ERROR"<<std::endl;
+        PC_LOG_ALL(PC_LOG_ERROR, "THERE WAS AN ERROR\n");
         std::exit(1);
       }
 
@@ -260,7 +259,7 @@ void meshGradation(apf::Mesh2* m, double gradingFactor)
       assert(!m->isOwned(ent));
 
       if(m->isOwned(ent)){
-        std::cout<<"Problem occurred\n";
+        PC_LOG_ALL(PC_LOG_ERROR, "Problem occurred\n");
         std::exit(1);
       }
 
@@ -289,8 +288,7 @@ void meshGradation(apf::Mesh2* m, double gradingFactor)
   m->end(it);
   m->destroyTag(isMarked);
 
-  if(!PCU_Comm_Self())
-    std::cout<<"Completed grading\n";
+  PC_LOG(PC_LOG_INFO, "Completed grading\n");
 }
 
 } // end namespace pc
@@ -0,0 +1,15 @@
+#include "pcThreads.h"
+
+namespace pc {
+
+  static int numThreads = 1;
+
+  void setNumThreads(int n) {
+    numThreads = (n > 0) ? n : 1;
+  }
+
+  int getNumThreads() {
+    return numThreads;
+  }
+
+}
@@ -0,0 +1,57 @@
+#ifndef PC_THREADS_H
+#define PC_THREADS_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace pc {
+
+  /* number of threads used by the threaded kernels of each rank,
+     defaults to one so MPI-only runs are not oversubscribed */
+  void setNumThreads(int n);
+
+  int getNumThreads();
+
+  /* split [0,n) into one contiguous chunk per thread and call
+     f(begin, end, thread) on each; the calling thread takes chunk 0 */
+  template <class F>
+  void parallelFor(size_t n, F const& f) {
+    size_t nt = (size_t)getNumThreads();
+    if (nt > n) nt = n;
+    if (nt <= 1) {
+      if (n) f((size_t)0, n, 0);
+      return;
+    }
+    size_t chunk = (n + nt - 1) / nt;
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nt; t++) {
+      size_t b = t * chunk;
+      size_t e = (b + chunk < n) ? b + chunk : n;
+      if (b >= e) break;
+      threads.push_back(std::thread([&f, b, e, t] { f(b, e, (int)t); }));
+    }
+    f((size_t)0, chunk, 0);
+    for (size_t t = 0; t < threads.size(); t++)
+      threads[t].join();
+  }
+
+  /* sum of f(i) over [0,n), one partial sum per thread */
+  template <class F>
+  double parallelSum(size_t n, F const& f) {
+    std::vector<double> partial(getNumThreads(), 0.0);
+    parallelFor(n, [&](size_t b, size_t e, int t) {
+      double s = 0;
+      for (size_t i = b; i < e; i++)
+        s += f(i);
+      partial[t] = s;
+    });
+    double s = 0;
+    for (size_t t = 0; t < partial.size(); t++)
+      s += partial[t];
+    return s;
+  }
+
+}
+
+#endif
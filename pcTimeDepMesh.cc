@@ -1,9 +1,16 @@
 #include "pcUpdateMesh.h"
+#include "pcTimeDepMesh.h"
+#include "pcLog.h"
 #include <PCU.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
 
 namespace pc {
-  /* ideally, this comes from some input file */
+  /* hardcoded grain cases, new cases use a motion schedule file */
   meshMotion getTDMeshMotion(int caseId, int step) {
     double offset, disp, rang, sfct;
     offset = 0.0;
@@ -85,4 +92,198 @@ namespace pc {
     return mm;
   }
 
+  double motionChannel::eval(double t) const {
+    if (t0.empty())
+      return 0.0;
+    size_t i = std::upper_bound(t0.begin(), t0.end(), t) - t0.begin();
+    if (i > 0) i--;
+    double tt = std::min(std::max(t, t0[i]), t1[i]);
+    double dt = tt - t0[i];
+    return c[0][i] + dt * (c[1][i] + dt * c[2][i]);
+  }
+
+  static void scheduleError(const char* filename, int line, const char* what) {
+    PC_LOG(PC_LOG_ERROR, "%s:%d: %s\n", filename, line, what);
+    abort();
+  }
+
+  static int getChannel(std::string const& name) {
+    static const char* names[MOTION_CHANNELS] =
+      {"tx", "ty", "tz", "px", "py", "pz", "ang", "scale"};
+    for (int i = 0; i < MOTION_CHANNELS; i++)
+      if (name == names[i])
+        return i;
+    return -1;
+  }
+
+  static void addSegment(motionChannel& ch, double t0, double t1,
+      double c0, double c1, double c2) {
+    ch.t0.push_back(t0);
+    ch.t1.push_back(t1);
+    ch.c[0].push_back(c0);
+    ch.c[1].push_back(c1);
+    ch.c[2].push_back(c2);
+  }
+
+  /* sort the segments by start time and reject overlaps */
+  static bool compileChannel(motionChannel& ch) {
+    size_t n = ch.t0.size();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(),
+        [&ch](size_t a, size_t b) { return ch.t0[a] < ch.t0[b]; });
+    motionChannel sorted;
+    sorted.constant = ch.constant;
+    for (size_t k = 0; k < n; k++) {
+      size_t i = order[k];
+      if (ch.t1[i] < ch.t0[i])
+        return false;
+      if (k && ch.t0[i] < sorted.t1.back())
+        return false;
+      addSegment(sorted, ch.t0[i], ch.t1[i], ch.c[0][i], ch.c[1][i], ch.c[2][i]);
+    }
+    ch = sorted;
+    return true;
+  }
+
+  static void readList(std::istringstream& ss, std::list<int>& l) {
+    int tag;
+    while (ss >> tag)
+      l.push_back(tag);
+  }
+
+  void loadMotionSchedule(const char* filename, motionSchedule& s) {
+    s = motionSchedule();
+    std::ifstream f(filename);
+    if (!f)
+      scheduleError(filename, 0, "could not open motion schedule");
+    std::string line, key;
+    int lineNum = 0;
+    bodySchedule* body = 0;
+    while (std::getline(f, line)) {
+      lineNum++;
+      size_t comment = line.find('#');
+      if (comment != std::string::npos)
+        line.erase(comment);
+      std::istringstream ss(line);
+      if (!(ss >> key))
+        continue;
+      if (key == "parSurFaces") readList(ss, s.parSurFaces);
+      else if (key == "parSurRegions") readList(ss, s.parSurRegions);
+      else if (key == "parSurEdges") readList(ss, s.parSurEdges);
+      else if (key == "disDefRegions") readList(ss, s.disDefRegions);
+      else if (key == "disSurRegions") readList(ss, s.disSurRegions);
+      else if (key == "body") {
+        bodySchedule b;
+        if (!(ss >> b.tag))
+          scheduleError(filename, lineNum, "body needs a model tag");
+        b.axis[0] = b.axis[1] = 0.0;
+        b.axis[2] = 1.0;
+        s.bodies.push_back(b);
+        body = &s.bodies.back();
+      }
+      else {
+        if (!body)
+          scheduleError(filename, lineNum, "motion given before the first body");
+        if (key == "axis") {
+          if (!(ss >> body->axis[0] >> body->axis[1] >> body->axis[2]))
+            scheduleError(filename, lineNum, "axis needs three components");
+          continue;
+        }
+        std::string name;
+        ss >> name;
+        int id = getChannel(name);
+        if (id < 0)
+          scheduleError(filename, lineNum, "unknown channel");
+        motionChannel& ch = body->channels[id];
+        if (ch.constant || (key == "const" && !ch.t0.empty()))
+          scheduleError(filename, lineNum, "const channels have a single value");
+        if (key == "const") {
+          double v;
+          if (!(ss >> v))
+            scheduleError(filename, lineNum, "const needs a value");
+          addSegment(ch, 0.0, 0.0, v, 0.0, 0.0);
+          ch.constant = true;
+        }
+        else if (key == "poly") {
+          double t0, t1, c[3] = {0.0, 0.0, 0.0};
+          if (!(ss >> t0 >> t1 >> c[0]))
+            scheduleError(filename, lineNum, "poly needs t0 t1 c0 [c1 [c2]]");
+          if (ss >> c[1]) ss >> c[2];
+          addSegment(ch, t0, t1, c[0], c[1], c[2]);
+        }
+        else if (key == "table") {
+          std::vector<double> ts, vs;
+          double t, v;
+          while (std::getline(f, line)) {
+            lineNum++;
+            comment = line.find('#');
+            if (comment != std::string::npos)
+              line.erase(comment);
+            std::istringstream row(line);
+            std::string first;
+            if (!(row >> first))
+              continue;
+            if (first == "end")
+              break;
+            t = atof(first.c_str());
+            if (!(row >> v))
+              scheduleError(filename, lineNum, "table rows are: time value");
+            if (!ts.empty() && t <= ts.back())
+              scheduleError(filename, lineNum, "table times must increase");
+            ts.push_back(t);
+            vs.push_back(v);
+          }
+          if (ts.empty())
+            scheduleError(filename, lineNum, "empty table");
+          if (ts.size() == 1)
+            addSegment(ch, ts[0], ts[0], vs[0], 0.0, 0.0);
+          for (size_t i = 0; i + 1 < ts.size(); i++)
+            addSegment(ch, ts[i], ts[i+1], vs[i],
+                (vs[i+1] - vs[i]) / (ts[i+1] - ts[i]), 0.0);
+        }
+        else
+          scheduleError(filename, lineNum, "unknown keyword");
+      }
+    }
+    for (size_t b = 0; b < s.bodies.size(); b++) {
+      for (int i = 0; i < MOTION_CHANNELS; i++)
+        if (!compileChannel(s.bodies[b].channels[i]))
+          scheduleError(filename, lineNum, "overlapping segments");
+      motionChannel& scale = s.bodies[b].channels[MOTION_SCALE];
+      if (scale.t0.empty()) {
+        addSegment(scale, 0.0, 0.0, 1.0, 0.0, 0.0);
+        scale.constant = true;
+      }
+    }
+    PC_LOG(PC_LOG_INFO, "loaded motion schedule %s with %lu bodies\n",
+        filename, (unsigned long)s.bodies.size());
+  }
+
+  meshMotion getTDMeshMotion(motionSchedule const& s, double t) {
+    meshMotion mm;
+    mm.caseId = 0;
+    mm.disDefRegions = s.disDefRegions;
+    mm.disSurRegions = s.disSurRegions;
+    mm.parSurRegions = s.parSurRegions;
+    mm.parSurFaces = s.parSurFaces;
+    mm.parSurEdges = s.parSurEdges;
+    for (size_t b = 0; b < s.bodies.size(); b++) {
+      bodySchedule const& body = s.bodies[b];
+      motionChannel const* ch = body.channels;
+      rigidBodyMotion mbm(body.tag, ch[MOTION_ANG].eval(t), ch[MOTION_SCALE].eval(t));
+      mbm.set_trans(ch[MOTION_TX].eval(t), ch[MOTION_TY].eval(t), ch[MOTION_TZ].eval(t));
+      mbm.set_rotaxis(body.axis[0], body.axis[1], body.axis[2]);
+      mbm.set_rotpt(ch[MOTION_PX].eval(t), ch[MOTION_PY].eval(t), ch[MOTION_PZ].eval(t));
+      mm.rigidBodyMotions.push_back(mbm);
+    }
+    return mm;
+  }
+
+  motionSchedule& getMotionSchedule() {
+    static motionSchedule s;
+    return s;
+  }
+
 }
@@ -0,0 +1,74 @@
+#ifndef PC_TIMEDEPMESH_H
+#define PC_TIMEDEPMESH_H
+
+#include "pcUpdateMesh.h"
+#include <list>
+#include <vector>
+
+namespace pc {
+
+  /* channels of a rigid body trajectory */
+  enum {
+    MOTION_TX, MOTION_TY, MOTION_TZ, // translation
+    MOTION_PX, MOTION_PY, MOTION_PZ, // rotation point
+    MOTION_ANG,                      // rotation angle
+    MOTION_SCALE,                    // scale factor
+    MOTION_CHANNELS
+  };
+
+  /* piecewise quadratic c0 + c1*(t-t0) + c2*(t-t0)^2 on sorted segments
+     [t0,t1]; time is clamped into the segment found by binary search, so
+     values hold before the first and after the last segment */
+  struct motionChannel {
+    std::vector<double> t0;
+    std::vector<double> t1;
+    std::vector<double> c[3];
+    bool constant;
+    motionChannel(): constant(false) {}
+    double eval(double t) const;
+  };
+
+  struct bodySchedule {
+    int tag;
+    double axis[3];
+    motionChannel channels[MOTION_CHANNELS];
+  };
+
+  /* compiled form of a motion schedule file:
+
+       parSurFaces 54 46 41       model entity lists of meshMotion
+       parSurRegions 1
+       body 1339                  following lines apply to this tag
+       axis 0 0 1
+       const ang 2.0
+       poly px 0 10 5e-4 2e-4     t0 t1 c0 [c1 [c2]]
+       table tx                   linear interpolation of t value rows
+       0 2.2e-4
+       10 2.2e-4
+       end
+
+     '#' starts a comment; channels that are not given are zero, except
+     the scale, which is one. Time is the phasta time step number, and
+     the values at a step are the transform of that step, applied when
+     nRigidBody is 0 (see getStepRigidBodyMotions) */
+  struct motionSchedule {
+    std::vector<bodySchedule> bodies;
+    std::list<int> disDefRegions;
+    std::list<int> disSurRegions;
+    std::list<int> parSurRegions;
+    std::list<int> parSurFaces;
+    std::list<int> parSurEdges;
+    bool empty() const { return bodies.empty(); }
+  };
+
+  void loadMotionSchedule(const char* filename, motionSchedule& s);
+
+  /* O(log n) per body and channel */
+  meshMotion getTDMeshMotion(motionSchedule const& s, double t);
+
+  /* the schedule named by pcMotionSchedule, loaded by loadControl */
+  motionSchedule& getMotionSchedule();
+
+}
+
+#endif
@@ -0,0 +1,541 @@
+#include "pcUntangle.h"
+#include "pcControl.h"
+#include "pcLog.h"
+#include "pcQuality.h"
+#include "pcThreads.h"
+#include <PCU.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <unordered_set>
+
+namespace pc {
+
+  enum { COMBINE_SUM, COMBINE_MIN };
+
+  struct contribution {
+    int vert;
+    int rank;
+    size_t at;
+    bool operator<(contribution const& o) const {
+      return vert < o.vert || (vert == o.vert && rank < o.rank);
+    }
+  };
+
+  /* collective; combine the n values per vertex of verts[0,count) over
+     all copies of the shared ones, folded in rank order so every copy
+     gets the same bits. A shared vertex must be in verts on every part */
+  static void combineShared(apf::Mesh* m, std::vector<apf::MeshEntity*> const& verts,
+      size_t count, std::unordered_map<apf::MeshEntity*, int> const& index,
+      int n, double* v, int op) {
+    std::vector<contribution> contribs;
+    std::vector<double> vals;
+    int self = PCU_Comm_Self();
+    apf::Copies remotes;
+    PCU_Comm_Begin();
+    for (size_t i = 0; i < count; i++) {
+      if (!m->isShared(verts[i]))
+        continue;
+      remotes.clear();
+      m->getRemotes(verts[i], remotes);
+      APF_ITERATE(apf::Copies, remotes, rit) {
+        PCU_COMM_PACK(rit->first, rit->second);
+        PCU_Comm_Pack(rit->first, v + i*n, n * sizeof(double));
+      }
+      contribution c = {(int)i, self, vals.size()};
+      contribs.push_back(c);
+      vals.insert(vals.end(), v + i*n, v + (i+1)*n);
+    }
+    PCU_Comm_Send();
+    while (PCU_Comm_Receive()) {
+      apf::MeshEntity* e;
+      PCU_COMM_UNPACK(e);
+      std::unordered_map<apf::MeshEntity*, int>::const_iterator it = index.find(e);
+      assert(it != index.end() && (size_t)it->second < count);
+      contribution c = {it->second, PCU_Comm_Sender(), vals.size()};
+      vals.resize(vals.size() + n);
+      PCU_Comm_Unpack(&vals[c.at], n * sizeof(double));
+      contribs.push_back(c);
+    }
+    std::sort(contribs.begin(), contribs.end());
+    for (size_t k = 0; k < contribs.size(); ) {
+      double* out = v + contribs[k].vert * n;
+      std::copy(&vals[contribs[k].at], &vals[contribs[k].at] + n, out);
+      size_t j = k + 1;
+      for (; j < contribs.size() && contribs[j].vert == contribs[k].vert; j++)
+        for (int c = 0; c < n; c++) {
+          double x = vals[contribs[j].at + c];
+          out[c] = (op == COMBINE_SUM) ? out[c] + x : std::min(out[c], x);
+        }
+      k = j;
+    }
+  }
+
+  /* copies of a wanted vertex become wanted on every part */
+  static void shareWanted(apf::Mesh* m, std::unordered_set<apf::MeshEntity*>& wanted) {
+    apf::Copies remotes;
+    PCU_Comm_Begin();
+    for (std::unordered_set<apf::MeshEntity*>::iterator it = wanted.begin();
+        it != wanted.end(); ++it) {
+      if (!m->isShared(*it))
+        continue;
+      remotes.clear();
+      m->getRemotes(*it, remotes);
+      APF_ITERATE(apf::Copies, remotes, rit)
+        PCU_COMM_PACK(rit->first, rit->second);
+    }
+    PCU_Comm_Send();
+    while (PCU_Comm_Receive()) {
+      apf::MeshEntity* e;
+      PCU_COMM_UNPACK(e);
+      wanted.insert(e);
+    }
+  }
+
+  static bool canMove(apf::Mesh* m, apf::MeshEntity* v) {
+    int dim = m->getDimension();
+    if (m->getModelType(m->toModel(v)) != dim)
+      return false;
+    apf::Adjacent elms;
+    m->getAdjacent(v, dim, elms);
+    for (size_t i = 0; i < elms.getSize(); i++)
+      if (m->getType(elms[i]) != apf::Mesh::TET)
+        return false;
+    return true;
+  }
+
+  /* regular tet with unit edges as the target shape */
+  static const double sqrt3 = 1.7320508075688772;
+  static const double Winv[3][3] = {
+    {1.0, -1.0 / sqrt3, -1.0 / (sqrt3 * 1.4142135623730951)},
+    {0.0,  2.0 / sqrt3, -1.0 / (sqrt3 * 1.4142135623730951)},
+    {0.0,  0.0,          1.2247448713915890}
+  };
+
+  static double det3(const double* a, const double* b, const double* c) {
+    return (a[1]*b[2] - a[2]*b[1]) * c[0]
+         + (a[2]*b[0] - a[0]*b[2]) * c[1]
+         + (a[0]*b[1] - a[1]*b[0]) * c[2];
+  }
+
+  /* shape sigma = 6*sqrt(2)*V/l_rms^3 of pcQuality, and the smoothed
+     objective |S|^2 / (3 h(sigma)^(2/3)) of Escobar et al. with
+     h(sigma) = (sigma + sqrt(sigma^2 + 4 delta^2)) / 2, where S maps the
+     unit regular tet onto this one, scaled by l_rms. It is 1 for the
+     regular tet and stays finite across inversion while delta > 0 */
+  static double tetShape(const double* const p[4], double sign, double* frob) {
+    double e[3][3];
+    for (int k = 0; k < 3; k++)
+      for (int d = 0; d < 3; d++)
+        e[k][d] = p[k+1][d] - p[0][d];
+    double l2 = 0;
+    for (int k = 0; k < 3; k++)
+      l2 += e[k][0]*e[k][0] + e[k][1]*e[k][1] + e[k][2]*e[k][2];
+    for (int a = 0; a < 3; a++)
+      for (int b = a + 1; b < 3; b++)
+        for (int d = 0; d < 3; d++)
+          l2 += (e[b][d] - e[a][d]) * (e[b][d] - e[a][d]);
+    l2 /= 6.0;
+    if (l2 <= 0) {
+      *frob = 0;
+      return 0;
+    }
+    double s2 = 0;
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++) {
+        double s = 0;
+        for (int k = 0; k < 3; k++)
+          s += e[k][i] * Winv[k][j];
+        s2 += s * s;
+      }
+    *frob = s2 / l2;
+    return sign * 1.4142135623730951 * det3(e[0], e[1], e[2]) / (l2 * sqrt(l2));
+  }
+
+  static double tetObjective(const double* const p[4], double sign, double delta2) {
+    double frob;
+    double sigma = tetShape(p, sign, &frob);
+    double h = 0.5 * (sigma + sqrt(sigma*sigma + 4.0 * delta2));
+    if (h <= 0)
+      return HUGE_VAL;
+    return frob / (3.0 * cbrt(h * h));
+  }
+
+  static double ballObjective(untangleCavity const& c, int i, const double* y,
+      double sign, double delta2) {
+    double f = 0;
+    for (int k = c.ballStart[i]; k < c.ballStart[i+1]; k++) {
+      const int* t = &c.tets[4 * c.ball[k]];
+      const double* p[4];
+      for (int j = 0; j < 4; j++)
+        p[j] = (t[j] == i) ? y : &c.x[3 * t[j]];
+      f += tetObjective(p, sign, delta2);
+    }
+    return f;
+  }
+
+  static void buildCavity(apf::Mesh* m, elementCoords const& ec,
+      std::vector<int> const& bad, int layers, untangleCavity& c) {
+    int dim = m->getDimension();
+    std::unordered_set<apf::MeshEntity*> wanted;
+    apf::Downward dv;
+    for (size_t b = 0; b < bad.size(); b++) {
+      int nv = m->getDownward(ec.elms[bad[b]], 0, dv);
+      wanted.insert(dv, dv + nv);
+    }
+    std::vector<apf::MeshEntity*> free;
+    for (int l = 0; ; l++) {
+      shareWanted(m, wanted);
+      std::vector<apf::MeshEntity*> list(wanted.begin(), wanted.end());
+      std::unordered_map<apf::MeshEntity*, int> idx;
+      std::vector<double> ok(list.size());
+      for (size_t i = 0; i < list.size(); i++) {
+        idx[list[i]] = (int)i;
+        ok[i] = canMove(m, list[i]) ? 1 : 0;
+      }
+      combineShared(m, list, list.size(), idx, 1, ok.empty() ? 0 : &ok[0], COMBINE_MIN);
+      free.clear();
+      for (size_t i = 0; i < list.size(); i++)
+        if (ok[i] > 0)
+          free.push_back(list[i]);
+      if (l == layers)
+        break;
+      for (size_t i = 0; i < free.size(); i++) {
+        apf::Adjacent elms;
+        m->getAdjacent(free[i], dim, elms);
+        for (size_t k = 0; k < elms.getSize(); k++) {
+          int nv = m->getDownward(elms[k], 0, dv);
+          wanted.insert(dv, dv + nv);
+        }
+      }
+    }
+    /* free vertices first, then the other vertices of their balls */
+    c.verts = free;
+    c.numFree = free.size();
+    c.index.clear();
+    for (size_t i = 0; i < free.size(); i++)
+      c.index[free[i]] = (int)i;
+    std::unordered_map<apf::MeshEntity*, int> tetIndex;
+    c.tets.clear();
+    c.ball.clear();
+    c.ballStart.assign(1, 0);
+    for (size_t i = 0; i < c.numFree; i++) {
+      apf::Adjacent elms;
+      m->getAdjacent(c.verts[i], dim, elms);
+      for (size_t k = 0; k < elms.getSize(); k++) {
+        std::unordered_map<apf::MeshEntity*, int>::iterator it = tetIndex.find(elms[k]);
+        if (it == tetIndex.end()) {
+          it = tetIndex.insert(std::make_pair(elms[k], (int)(c.tets.size() / 4))).first;
+          m->getDownward(elms[k], 0, dv);
+          for (int j = 0; j < 4; j++) {
+            std::unordered_map<apf::MeshEntity*, int>::iterator vit = c.index.find(dv[j]);
+            if (vit == c.index.end()) {
+              vit = c.index.insert(std::make_pair(dv[j], (int)c.verts.size())).first;
+              c.verts.push_back(dv[j]);
+            }
+            c.tets.push_back(vit->second);
+          }
+        }
+        c.ball.push_back(it->second);
+      }
+      c.ballStart.push_back((int)c.ball.size());
+    }
+    c.x.resize(3 * c.verts.size());
+    apf::Vector3 p;
+    for (size_t i = 0; i < c.verts.size(); i++) {
+      m->getPoint(c.verts[i], 0, p);
+      for (int d = 0; d < 3; d++)
+        c.x[3*i + d] = p[d];
+    }
+    /* finite difference step from the edges at each free vertex, the
+       same on every copy */
+    std::vector<double> edges(2 * c.numFree, 0.0);
+    for (size_t i = 0; i < c.numFree; i++)
+      for (int k = c.ballStart[i]; k < c.ballStart[i+1]; k++) {
+        const int* t = &c.tets[4 * c.ball[k]];
+        for (int j = 0; j < 4; j++) {
+          if (t[j] == (int)i)
+            continue;
+          double l2 = 0;
+          for (int d = 0; d < 3; d++)
+            l2 += (c.x[3*t[j] + d] - c.x[3*i + d]) * (c.x[3*t[j] + d] - c.x[3*i + d]);
+          edges[2*i] += sqrt(l2);
+          edges[2*i + 1] += 1;
+        }
+      }
+    combineShared(m, c.verts, c.numFree, c.index, 2, edges.empty() ? 0 : &edges[0], COMBINE_SUM);
+    c.h.resize(c.numFree);
+    for (size_t i = 0; i < c.numFree; i++)
+      c.h[i] = 1e-4 * edges[2*i] / edges[2*i + 1];
+  }
+
+  /* order of a vertex known to every copy: owner rank and owner address */
+  struct vertexKey {
+    size_t hash;
+    int rank;
+    size_t ptr;
+    bool operator>(vertexKey const& o) const {
+      if (hash != o.hash) return hash > o.hash;
+      if (rank != o.rank) return rank > o.rank;
+      return ptr > o.ptr;
+    }
+  };
+
+  static vertexKey getKey(apf::Mesh* m, apf::MeshEntity* v) {
+    vertexKey k;
+    k.rank = m->getOwner(v);
+    apf::MeshEntity* e = v;
+    if (k.rank != PCU_Comm_Self()) {
+      apf::Copies remotes;
+      m->getRemotes(v, remotes);
+      e = remotes[k.rank];
+    }
+    k.ptr = reinterpret_cast<size_t>(e);
+    /* splitmix64 finalizer, so the colors do not follow memory order */
+    unsigned long long z = (unsigned long long)k.ptr + 0x9E3779B97F4A7C15ULL * (k.rank + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    k.hash = (size_t)(z ^ (z >> 31));
+    return k;
+  }
+
+  /* collective; each round takes the uncolored free vertices that beat
+     every uncolored free neighbour on every part, so no two vertices of
+     one color share a tet, even across parts. Returns the color count */
+  static int colorCavity(apf::Mesh* m, untangleCavity& c) {
+    std::vector<vertexKey> keys(c.numFree);
+    for (size_t i = 0; i < c.numFree; i++)
+      keys[i] = getKey(m, c.verts[i]);
+    c.color.assign(c.numFree, -1);
+    int round = 0;
+    std::vector<double> sel(c.numFree);
+    while (PCU_Or(std::count(c.color.begin(), c.color.end(), -1) > 0)) {
+      for (size_t i = 0; i < c.numFree; i++) {
+        sel[i] = (c.color[i] < 0) ? 1 : 0;
+        for (int k = c.ballStart[i]; k < c.ballStart[i+1] && sel[i] > 0; k++) {
+          const int* t = &c.tets[4 * c.ball[k]];
+          for (int j = 0; j < 4; j++) {
+            int w = t[j];
+            if (w != (int)i && w < (int)c.numFree && c.color[w] < 0 && keys[w] > keys[i])
+              sel[i] = 0;
+          }
+        }
+      }
+      combineShared(m, c.verts, c.numFree, c.index, 1, sel.empty() ? 0 : &sel[0], COMBINE_MIN);
+      for (size_t i = 0; i < c.numFree; i++)
+        if (c.color[i] < 0 && sel[i] > 0)
+          c.color[i] = round;
+      round++;
+    }
+    return round;
+  }
+
+  /* H + mu I = L L^T for growing mu until it is positive definite */
+  static void newtonStep(const double* g, const double* H, double* p) {
+    double tr = fabs(H[0]) + fabs(H[4]) + fabs(H[8]);
+    double mu = 0;
+    for (int attempt = 0; attempt < 12; attempt++) {
+      double L[3][3] = {{0}};
+      bool pd = true;
+      for (int i = 0; i < 3 && pd; i++)
+        for (int j = 0; j <= i; j++) {
+          double s = H[3*i + j] + (i == j ? mu : 0);
+          for (int k = 0; k < j; k++)
+            s -= L[i][k] * L[j][k];
+          if (i == j) {
+            if (!(s > 0)) {
+              pd = false;
+              break;
+            }
+            L[i][i] = sqrt(s);
+          }
+          else
+            L[i][j] = s / L[j][j];
+        }
+      if (pd) {
+        double y[3];
+        for (int i = 0; i < 3; i++) {
+          y[i] = -g[i];
+          for (int k = 0; k < i; k++)
+            y[i] -= L[i][k] * y[k];
+          y[i] /= L[i][i];
+        }
+        for (int i = 2; i >= 0; i--) {
+          p[i] = y[i];
+          for (int k = i + 1; k < 3; k++)
+            p[i] -= L[k][i] * p[k];
+          p[i] /= L[i][i];
+        }
+        return;
+      }
+      mu = (mu == 0) ? 1e-6 * tr + DBL_MIN : mu * 10;
+    }
+    p[0] = p[1] = p[2] = 0;
+  }
+
+  static double cavityMinShape(untangleCavity const& c, double sign, double minQuality,
+      long* bad) {
+    double smin = DBL_MAX;
+    long n = 0;
+    for (size_t t = 0; t < c.tets.size() / 4; t++) {
+      const double* p[4];
+      for (int j = 0; j < 4; j++)
+        p[j] = &c.x[3 * c.tets[4*t + j]];
+      double frob;
+      double s = tetShape(p, sign, &frob);
+      smin = std::min(smin, s);
+      if (s <= 0 || s < minQuality)
+        n++;
+    }
+    *bad = n;
+    return smin;
+  }
+
+  enum { NUM_TRIALS = 5 };
+
+  /* collective; damped Newton sweeps over the colors, derivatives by
+     finite differences of the ball objectives summed over the copies */
+  static int optimizeCavity(apf::Mesh* m, untangleCavity& c, int ncolors,
+      double sign, double minQuality, int sweeps) {
+    static const double alphas[NUM_TRIALS] = {1.0, 0.5, 0.25, 0.125, 0.0625};
+    std::vector<double> gh(13 * c.numFree);
+    std::vector<double> trial(NUM_TRIALS * c.numFree);
+    std::vector<double> step(3 * c.numFree);
+    int sweep = 0;
+    while (sweep < sweeps) {
+      long bad;
+      double smin = PCU_Min_Double(cavityMinShape(c, sign, minQuality, &bad));
+      const double eps = 1e-3;
+      double delta2 = (smin < eps) ? eps * (eps - smin) : 0;
+      double maxMove = 0;
+      for (int col = 0; col < ncolors; col++) {
+        std::vector<int> L;
+        for (size_t i = 0; i < c.numFree; i++)
+          if (c.color[i] == col)
+            L.push_back((int)i);
+        std::fill(gh.begin(), gh.end(), 0.0);
+        parallelFor(L.size(), [&](size_t b, size_t e, int) {
+          for (size_t q = b; q < e; q++) {
+            int i = L[q];
+            double h = c.h[i];
+            double y[3];
+            const double* x = &c.x[3*i];
+            double* o = &gh[13*i];
+            double f0 = ballObjective(c, i, x, sign, delta2);
+            double fp[3], fm[3];
+            for (int a = 0; a < 3; a++) {
+              std::copy(x, x + 3, y);
+              y[a] = x[a] + h;
+              fp[a] = ballObjective(c, i, y, sign, delta2);
+              y[a] = x[a] - h;
+              fm[a] = ballObjective(c, i, y, sign, delta2);
+              o[a] = (fp[a] - fm[a]) / (2*h);
+              o[3 + 4*a] = (fp[a] - 2*f0 + fm[a]) / (h*h);
+            }
+            for (int a = 0; a < 3; a++)
+              for (int b2 = a + 1; b2 < 3; b2++) {
+                double f[4];
+                for (int s = 0; s < 4; s++) {
+                  std::copy(x, x + 3, y);
+                  y[a] += (s & 1) ? -h : h;
+                  y[b2] += (s & 2) ? -h : h;
+                  f[s] = ballObjective(c, i, y, sign, delta2);
+                }
+                double hab = (f[0] - f[1] - f[2] + f[3]) / (4*h*h);
+                o[3 + 3*a + b2] = o[3 + 3*b2 + a] = hab;
+              }
+            o[12] = f0;
+          }
+        });
+        combineShared(m, c.verts, c.numFree, c.index, 13, gh.empty() ? 0 : &gh[0], COMBINE_SUM);
+        std::fill(trial.begin(), trial.end(), 0.0);
+        parallelFor(L.size(), [&](size_t b, size_t e, int) {
+          for (size_t q = b; q < e; q++) {
+            int i = L[q];
+            double* p = &step[3*i];
+            newtonStep(&gh[13*i], &gh[13*i + 3], p);
+            double y[3];
+            for (int k = 0; k < NUM_TRIALS; k++) {
+              for (int d = 0; d < 3; d++)
+                y[d] = c.x[3*i + d] + alphas[k] * p[d];
+              trial[NUM_TRIALS*i + k] = ballObjective(c, i, y, sign, delta2);
+            }
+          }
+        });
+        combineShared(m, c.verts, c.numFree, c.index, NUM_TRIALS,
+            trial.empty() ? 0 : &trial[0], COMBINE_SUM);
+        /* every copy picks the same step from the same sums */
+        for (size_t q = 0; q < L.size(); q++) {
+          int i = L[q];
+          double best = gh[13*i + 12];
+          int pick = -1;
+          for (int k = 0; k < NUM_TRIALS; k++)
+            if (trial[NUM_TRIALS*i + k] < best) {
+              best = trial[NUM_TRIALS*i + k];
+              pick = k;
+            }
+          if (pick < 0)
+            continue;
+          double move = 0;
+          for (int d = 0; d < 3; d++) {
+            double dx = alphas[pick] * step[3*i + d];
+            c.x[3*i + d] += dx;
+            move += dx * dx;
+          }
+          maxMove = std::max(maxMove, sqrt(move) * 1e-4 / c.h[i]);
+        }
+      }
+      sweep++;
+      maxMove = PCU_Max_Double(maxMove);
+      cavityMinShape(c, sign, minQuality, &bad);
+      if (!PCU_Add_Long(bad) && maxMove < 1e-3)
+        break;
+    }
+    return sweep;
+  }
+
+  long untangleMesh(apf::Mesh2* m) {
+    control const& ctrl = getControl();
+    if (!ctrl.untangle)
+      return 0;
+    double t0 = PCU_Time();
+    elementCoords ec;
+    extractElementCoords(m, ec);
+    qualityReport r;
+    scanQuality(ec, r, true);
+    if (!r.numInvalid)
+      return 0;
+    std::vector<int> bad;
+    findBadElements(ec, ctrl.untangleQuality, bad);
+    long numBad = PCU_Add_Long((long)bad.size());
+    if (!numBad)
+      return 0;
+    double sign = elementOrientation(ec);
+    untangleCavity c;
+    buildCavity(m, ec, bad, ctrl.untangleLayers, c);
+    int ncolors = colorCavity(m, c);
+    int sweeps = optimizeCavity(m, c, ncolors, sign, ctrl.untangleQuality,
+        ctrl.untangleSweeps);
+    apf::Vector3 p;
+    for (size_t i = 0; i < c.numFree; i++) {
+      for (int d = 0; d < 3; d++)
+        p[d] = c.x[3*i + d];
+      m->setPoint(c.verts[i], 0, p);
+    }
+    extractElementCoords(m, ec);
+    findBadElements(ec, ctrl.untangleQuality, bad);
+    long numLeft = PCU_Add_Long((long)bad.size());
+    long numOwned = 0;
+    for (size_t i = 0; i < c.numFree; i++)
+      if (m->isOwned(c.verts[i]))
+        numOwned++;
+    numOwned = PCU_Add_Long(numOwned);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "untangle: %ld bad elements, %ld free vertices in %d colors, "
+        "%d sweeps, %ld bad left, %f seconds\n", numBad, numOwned, ncolors, sweeps,
+        numLeft, t1 - t0);
+    return numLeft;
+  }
+
+}
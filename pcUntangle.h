@@ -0,0 +1,37 @@
+#ifndef PC_UNTANGLE_H
+#define PC_UNTANGLE_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <unordered_map>
+#include <vector>
+
+namespace pc {
+
+  /* the free vertices around the bad elements of a part and the tets
+     of their balls; a shared vertex is free on every part or none, and
+     every copy computes the same moves, so no synchronization is needed */
+  struct untangleCavity {
+    std::vector<apf::MeshEntity*> verts; // free vertices first, then the rest of the balls
+    std::unordered_map<apf::MeshEntity*, int> index;
+    size_t numFree;
+    std::vector<double> x;         // 3 coordinates per vertex
+    std::vector<int> tets;         // 4 vertex ids per cavity tet, mesh order
+    std::vector<int> ballStart;    // tets of free vertex i: ball[ballStart[i]] ..
+    std::vector<int> ball;
+    std::vector<int> color;        // per free vertex, no two in one tet share a color
+    std::vector<double> h;         // finite difference step per free vertex
+  };
+
+  /* collective; when the mesh has invalid elements, untangle and smooth
+     the cavities of the invalid elements and the tets below
+     pcUntangleQuality by moving their interior vertices, with
+     pcUntangleLayers extra rings of vertices. A valid mesh is left
+     alone. Only vertices whose elements are all tets move. Coordinates
+     are written with setPoint, so Simmetrix meshes are not supported.
+     Returns the number of bad elements left */
+  long untangleMesh(apf::Mesh2* m);
+
+}
+
+#endif
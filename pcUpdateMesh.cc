@@ -2,6 +2,20 @@
 #include "pcAdapter.h"
 #include "pcSmooth.h"
 #include "pcWriteFiles.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include "pcMotionBuffer.h"
+#include "pcQuality.h"
+#include "pcVerify.h"
+#include "pcBypass.h"
+#include "pcControl.h"
+#include "pcRigidTransform.h"
+#include "pcElasticMover.h"
+#include "pcRbfMover.h"
+#include "pcUntangle.h"
+#include "pcBLCompress.h"
+#include "pcParamCache.h"
+#include "pcProximity.h"
 #include <SimPartitionedMesh.h>
 #include "SimAdvMeshing.h"
 #include "SimModel.h"
@@ -19,9 +33,11 @@
 #include <phastaChef.h>
 #include <string.h>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
 #include <ctime>
 #include <sstream>
+#include <unordered_map>
 
 extern void MSA_setBLSnapping(pMSAdapt, int onoff);
 extern void MSA_setAdaptExtrusion(pMSAdapt, int onoff);
@@ -29,37 +45,73 @@ extern void  MS_reparameterizeForDiscrete(pMesh);
 
 namespace pc {
 
+  void resetRigidBodyTotals(ph::Input& in) {
+    for (size_t i_nrbs = 0; (int)i_nrbs < in.nRigidBody; i_nrbs++) {
+      for (size_t i_rbpd = 0; (int)i_rbpd < 3; i_rbpd++)
+        in.rbParamData[i_rbpd+i_nrbs*(size_t)in.nRBParam] = 0.0;
+      for (size_t i_rbpd = 12; (int)i_rbpd < 13; i_rbpd++)
+        in.rbParamData[i_rbpd+i_nrbs*(size_t)in.nRBParam] = 0.0;
+    }
+  }
+
+  void readAndAttachFields(ph::Input& in, apf::Mesh2*& m) {
+    chef::readAndAttachFields(in, m);
+    if (getControl().motionExchange != EXCHANGE_BOUNDARY)
+      return;
+    apf::Field* full = m->findField("motion_coords");
+    if (full)
+      apf::destroyField(full);
+  }
+
+  /* without motion_coords only the rigid bodies are moved, using the
+     transforms accumulated by phasta since the last update */
+  static bool updateAPFRigidBodies(ph::Input& in, apf::Mesh2* m) {
+    moveRigidBodies(m, getRigidBodyMotions(in));
+    apf::synchronize(m->getCoordinateField());
+    resetRigidBodyTotals(in);
+    return true;
+  }
+
   bool updateAPFCoord(ph::Input& in, apf::Mesh2* m) {
     apf::Field* f = m->findField("motion_coords");
+    if (!f && hasRigidBodyMotions(in))
+      return updateAPFRigidBodies(in, m);
     assert(f);
-    double* vals = new double[apf::countComponents(f)];
     assert(apf::countComponents(f) == 3);
-    apf::MeshEntity* vtx;
-    apf::Vector3 points;
-    apf::MeshIterator* itr = m->begin(0);
-    while( (vtx = m->iterate(itr)) ) {
-      apf::getComponents(f, vtx, 0, vals);
-      for ( int i = 0; i < 3; i++ )  points[i] = vals[i];
-      m->setPoint(vtx, 0, points);
+    /* the targets go through the shared motion buffer, owned copies are
+       written into the coordinate field in one pass and the part
+       boundary is synchronized once afterwards */
+    double t0 = PCU_Time();
+    motionBuffer& mb = getMotionBuffer();
+    collectVertices(m, mb);
+    gatherMotion(m, f, mb);
+    apf::Field* coords = m->getCoordinateField();
+    double vals[3];
+    for (size_t i = 0; i < mb.size(); i++) {
+      if (!m->isOwned(mb.verts[i]))
+        continue;
+      for (int d = 0; d < 3; d++)
+        vals[d] = mb.target[d][i];
+      apf::setComponents(coords, mb.verts[i], 0, vals);
     }
-    m->end(itr);
-    delete [] vals;
-    pc::writeSequence(m, in.timeStepNumber, "pvtu_mesh_");
+    apf::synchronize(coords);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "coordinates updated in %f seconds\n", t1 - t0);
+    if (getControl().writeMotionVtk)
+      pc::writeSequence(m, in.timeStepNumber, "pvtu_mesh_");
     return true;
   }
 
   void addImproverInMover(pMeshMover& mmover, pPList sim_fld_lst) {
     // mesh improver
-    if(!PCU_Comm_Self())
-      printf("Add mesh improver attributes\n");
+    PC_LOG(PC_LOG_INFO, "Add mesh improver attributes\n");
     pVolumeMeshImprover vmi = MeshMover_createImprover(mmover);
     pc::setupSimImprover(vmi, sim_fld_lst);
   }
 
   void addAdapterInMover(pMeshMover& mmover,  pPList& sim_fld_lst, ph::Input& in, apf::Mesh2*& m) {
     // mesh adapter
-    if(!PCU_Comm_Self())
-      printf("Add mesh adapter attributes\n");
+    PC_LOG(PC_LOG_INFO, "Add mesh adapter attributes\n");
     pMSAdapt msa = MeshMover_createAdapter(mmover);
     pc::setupSimAdapter(msa, in, m, sim_fld_lst);
   }
@@ -72,14 +124,12 @@ namespace pc {
 
     // we assume one part per processor
     if (totalNumProcs != totalNumParts) {
-      if( !PCU_Comm_Self() )
-        fprintf(stderr, "Error: N of procs %d not equal to N of parts %d\n",
-                totalNumProcs, totalNumParts);
+      PC_LOG(PC_LOG_ERROR, "Error: N of procs %d not equal to N of parts %d\n",
+             totalNumProcs, totalNumParts);
     }
 
     // start load balance
-    if(!PCU_Comm_Self())
-      printf("Start load balance\n");
+    PC_LOG(PC_LOG_INFO, "Start load balance\n");
     pPartitionOpts pOpts = PartitionOpts_new();
     // Set total no. of parts
     PartitionOpts_setTotalNumParts(pOpts, totalNumParts);
@@ -87,12 +137,12 @@ namespace pc {
     PartitionOpts_setProcWtEqual(pOpts);
     PM_partition(pmesh, pOpts, progress);     // Do the partitioning
     PartitionOpts_delete(pOpts);              // Done with options
+    pc::markTopologyChanged();
     // print out elements of each part
     pMesh mesh = PM_mesh(pmesh,0);
     int numElmOnPart = M_numRegions(mesh);
     long numTolElm = PCU_Add_Long(numElmOnPart);
-    if(!PCU_Comm_Self())
-      printf("Total No. of Elm: %d\n", numTolElm);
+    PC_LOG(PC_LOG_INFO, "Total No. of Elm: %ld\n", numTolElm);
   }
 
 
@@ -164,8 +214,7 @@ if (pm) {
     fclose (sFile);
 
     // write serial mesh and model
-    if(!PCU_Comm_Self())
-      printf("write discrete model and serial mesh\n");
+    PC_LOG(PC_LOG_INFO, "write discrete model and serial mesh\n");
     GM_write(M_model(pm), "discreteModel_serial.smd", 0, progress);
     M_write(pm, "mesh_serial.sms", 0, progress);
 /*
@@ -238,10 +287,7 @@ if (pm) {
 
     // declaration
     pGRegion modelRegion;
-    VIter vIter;
     pVertex meshVertex;
-    double disp[3];
-    double xyz[3];
 
 /*
     pMesh pm = M_createFromParMesh(ppm,3,progress);
@@ -259,48 +305,35 @@ if (pm) {
     GEntMeshMigrator_run(gmig, progress);
     GEntMeshMigrator_delete(gmig);
 */
-    pMesh pm = PM_mesh(ppm,0);
-
-    if(!PCU_Comm_Self())
-      printf("write mesh: before_mover.sms\n");
+    PC_LOG(PC_LOG_INFO, "write mesh: before_mover.sms\n");
     PM_write(ppm, "before_mover.sms", progress);
 
     apf::Field* f = m->findField("motion_coords");
     assert(f);
-    double* vals = new double[apf::countComponents(f)];
-    assert(apf::countComponents(f) == 3);
+    motionBuffer& mb = getMotionBuffer();
+    collectVertices(m, mb);
+    gatherMotion(m, f, mb);
 
     // start transfer to pField
-    if(!PCU_Comm_Self())
-      printf("Start transfer to pField\n");
+    PC_LOG(PC_LOG_INFO, "Start transfer to pField\n");
     pPolyField pf = PolyField_new(1, 0);
     pField dispFd = Field_new(ppm, 3, "disp", "displacement", ShpLagrange, 1, 1, 1, pf);
     Field_apply(dispFd, 3, progress);
     pDofGroup dof;
 
     // mesh motion of vertices in region
-    vIter = M_vertexIter(pm);
-    while((meshVertex = VIter_next(vIter))){
-      apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-      apf::getComponents(f, vtx, 0, vals);
-      V_coord(meshVertex, xyz);
-      disp[0] = vals[0] - xyz[0];
-      disp[1] = vals[1] - xyz[1];
-      disp[2] = vals[2] - xyz[2];
-
+    for (size_t i = 0; i < mb.size(); i++) {
+      meshVertex = reinterpret_cast<pVertex>(mb.verts[i]);
       for(int eindex = 0; (dof = Field_entDof(dispFd,meshVertex,eindex)); eindex++) {
         int dofs_per_node = DofGroup_numComp(dof);
         assert(dofs_per_node == 3);
         for(int ii = 0; ii < dofs_per_node; ii++)
-          DofGroup_setValue(dof,ii,0,disp[ii]);
+          DofGroup_setValue(dof,ii,0,mb.disp[ii][i]);
       }
     }
-    VIter_delete(vIter);
-    delete [] vals;
 
     // do real work
-    if(!PCU_Comm_Self())
-      printf("write sim field\n");
+    PC_LOG(PC_LOG_INFO, "write sim field\n");
     Field_write(dispFd, "dispFd.fld", 0, NULL, progress);
 
     // used to write discrete model at a certain time step
@@ -322,8 +355,7 @@ if (pm) {
     }
 */
     // write model and mesh
-    if(!PCU_Comm_Self())
-      printf("write mesh after creating discrete model: after_mover.sms\n");
+    PC_LOG(PC_LOG_INFO, "write mesh after creating discrete model: after_mover.sms\n");
     writeSIMModel(model, in.timeStepNumber, "sim_model_");
     writeSIMMesh(ppm, in.timeStepNumber, "sim_mesh_");
 
@@ -387,8 +419,7 @@ if (pm) {
     double mode_zone_min = proj_disp + tail - mode_zone_left_dis_tail;
     double mode_zone_max = proj_disp + head + mode_zone_rigt_dis_head;
 
-    if(!PCU_Comm_Self())
-      printf("tail and head and proj_disp = %f and %f and %f\n",tail,head,proj_disp);
+    PC_LOG(PC_LOG_INFO, "tail and head and proj_disp = %f and %f and %f\n",tail,head,proj_disp);
 
     // set refinement zone 1: around the projectile size = D/40
     apf::Vector3 cur_size = apf::Vector3(0.0,0.0,0.0);
@@ -437,13 +468,293 @@ if (pm) {
 // hardcoding }
 
 // check if a model entity is (on) a rigid body
-  int isOnRigidBody(pGModel model, pGEntity modelEnt, std::vector<ph::rigidBodyMotion> rbms) {
+  int isOnRigidBody(pGModel model, pGEntity modelEnt, std::vector<ph::rigidBodyMotion> const& rbms) {
     for(unsigned id = 0; id < rbms.size(); id++)
       if(GEN_inClosure(GM_entityByTag(model, 3, rbms[id].tag), modelEnt)) return (int)id;
     // not find
     return -1;
   }
 
+  /* the part of a rigid body motion from fraction a to fraction b of
+     it; the part rotates about the rotation point carried along by the
+     part before a, so consecutive parts compose to the whole motion */
+  static std::vector<ph::rigidBodyMotion> substepMotions(
+      std::vector<ph::rigidBodyMotion> const& rbms, double a, double b) {
+    std::vector<ph::rigidBodyMotion> out(rbms);
+    if (a == 0 && b == 1)
+      return out;
+    for (size_t i = 0; i < out.size(); i++) {
+      for (int d = 0; d < 3; d++) {
+        out[i].rotpt[d] += a * rbms[i].trans[d];
+        out[i].trans[d] *= b - a;
+      }
+      out[i].rotang *= b - a;
+      if (rbms[i].scale > 0)
+        out[i].scale = pow(rbms[i].scale, b - a);
+    }
+    return out;
+  }
+
+  /* collective; number of substeps that keep linear interpolation of the
+     prescribed motion valid: motion_coords, with the rigid body closures
+     moved by their transforms instead */
+  static int countMotionSubsteps(apf::Mesh* m, classificationIndex& cidx,
+      motionBuffer const& mb, std::vector<ph::rigidBodyMotion> const& rbms) {
+    control const& c = getControl();
+    if (c.maxSubsteps <= 1)
+      return 1;
+    double t0 = PCU_Time();
+    motionBuffer pred;
+    pred.verts = mb.verts;
+    for (int d = 0; d < 3; d++) {
+      pred.x[d] = mb.x[d];
+      pred.target[d] = mb.target[d];
+      pred.disp[d].resize(mb.size());
+    }
+    std::vector<int> const* stackBody = c.blRigidMotion ? &getRigidStackBodies(m, cidx) : 0;
+    for (size_t b = 0; b < rbms.size(); b++) {
+      std::vector<int> ids;
+      for (int dim = 0; dim <= 3; dim++)
+        for (size_t i = 0; i < cidx.entities[dim].size(); i++)
+          if (cidx.entities[dim][i].rigidBody == (int)b)
+            ids.insert(ids.end(), cidx.entities[dim][i].verts.begin(),
+                cidx.entities[dim][i].verts.end());
+      if (stackBody)
+        for (size_t i = 0; i < stackBody->size(); i++)
+          if ((*stackBody)[i] == (int)b)
+            ids.push_back((int)i);
+      if (ids.empty())
+        continue;
+      std::vector<double> x[3];
+      for (int d = 0; d < 3; d++) {
+        x[d].resize(ids.size());
+        for (size_t i = 0; i < ids.size(); i++)
+          x[d][i] = mb.x[d][ids[i]];
+      }
+      double* const xp[3] = {&x[0][0], &x[1][0], &x[2][0]};
+      applyRigidTransform(makeRigidTransform(toRigidBodyMotion(rbms[b])), ids.size(), xp, xp);
+      for (int d = 0; d < 3; d++)
+        for (size_t i = 0; i < ids.size(); i++)
+          pred.target[d][ids[i]] = x[d][i];
+    }
+    computeDisplacements(pred);
+    std::unordered_map<apf::MeshEntity*, int> index;
+    for (size_t i = 0; i < pred.size(); i++)
+      index[pred.verts[i]] = (int)i;
+    elementCoords ec;
+    extractElementCoords(m, ec);
+    std::vector<double> disp;
+    extractElementMotion(m, ec, index, pred, disp);
+    double t = invertingFraction(ec, disp);
+    int k = 1;
+    if (t <= 0)
+      PC_LOG(PC_LOG_WARN, "mesh is invalid before the motion, no substeps\n");
+    else if (t <= 1) {
+      k = (int)ceil(1.0 / (c.substepSafety * t));
+      if (k > c.maxSubsteps) {
+        PC_LOG(PC_LOG_WARN, "motion inverts elements at %f of the step, "
+            "limited to %d substeps\n", t, c.maxSubsteps);
+        k = c.maxSubsteps;
+      }
+    }
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "inversion predictor: first inversion at %f of the motion, "
+        "%d substeps, %f seconds\n", std::min(t, 1.0), k, t1 - t0);
+    return k;
+  }
+
+  /* final position of the vertices that existed before the first substep;
+     prescribed marks the compressed boundary layer vertices */
+  struct finalTargets {
+    std::unordered_map<pVertex, int> index;
+    std::vector<double> x[3];
+    std::vector<char> prescribed;
+  };
+
+  /* fill mb with the current vertices, each known vertex targeting frac
+     of the way to its final position; vertices made by an earlier
+     substep are not known and left free */
+  static classificationIndex& gatherSubstep(apf::Mesh* m, pGModel model, pMesh pm,
+      std::vector<int> const& rbTags, finalTargets const& ft, double frac,
+      motionBuffer& mb, std::vector<char>& known) {
+    classificationIndex& cidx = getClassificationIndex(model, pm, rbTags);
+    mb.verts.resize(cidx.vertices.size());
+    for (size_t i = 0; i < cidx.vertices.size(); i++)
+      mb.verts[i] = reinterpret_cast<apf::MeshEntity*>(cidx.vertices[i]);
+    gatherCoordinates(m, mb);
+    known.assign(mb.size(), 0);
+    for (size_t i = 0; i < mb.size(); i++) {
+      std::unordered_map<pVertex, int>::const_iterator it = ft.index.find(cidx.vertices[i]);
+      if (it == ft.index.end())
+        continue;
+      known[i] = ft.prescribed[it->second] ? 2 : 1;
+      for (int d = 0; d < 3; d++)
+        mb.target[d][i] = mb.x[d][i] + frac * (ft.x[d][it->second] - mb.x[d][i]);
+    }
+    computeDisplacements(mb);
+    return cidx;
+  }
+
+  /* prescribe the motion in mb of the known vertices, by classification;
+     with pcBLRigidMotion the boundary layer stacks on a rigid body move
+     with its transform, so only the vertices outside them are solved for.
+     A known value of 2 keeps the target of a compressed stack vertex */
+  static void setMoverMotion(apf::Mesh* m, pMeshMover mmover,
+      classificationIndex& cidx, motionBuffer const& mb,
+      std::vector<char> const& known, std::vector<ph::rigidBodyMotion> const& rbms) {
+    pVertex meshVertex;
+    double newpt[3];
+    double newpar[2];
+    long numSurfaceMoves = 0;
+    long numStackMoves = 0;
+    std::vector<int> const* stackBody =
+      getControl().blRigidMotion ? &getRigidStackBodies(m, cidx) : 0;
+    std::vector<rigidTransform> transforms(rbms.size());
+    for (size_t b = 0; b < rbms.size(); b++)
+      transforms[b] = makeRigidTransform(toRigidBodyMotion(rbms[b]));
+    PC_LOG(PC_LOG_DEBUG, "Starting loop over model regions\n");
+    for (size_t i = 0; i < cidx.entities[3].size(); i++) {
+      modelEntityInfo& info = cidx.entities[3][i];
+      pGRegion modelRegion = (pGRegion) info.ent;
+      int id = info.rigidBody;
+      if (id >= 0) {
+        PC_LOG_ALL(PC_LOG_DEBUG, "Rigid body detected: region %d\n", GEN_tag(modelRegion));
+        assert(!info.discrete); // should be parametric geometry
+        ph::rigidBodyMotion rbm = rbms[id];
+        MeshMover_setTransform(mmover, modelRegion, rbm.trans, rbm.rotaxis,
+            rbm.rotpt, rbm.rotang, rbm.scale);
+        continue;
+      }
+      for (size_t j = 0; j < info.verts.size(); j++) {
+        int lid = info.verts[j];
+        int body = stackBody && known[lid] != 2 ? (*stackBody)[lid] : -1;
+        if (!known[lid] && body < 0) continue;
+        meshVertex = cidx.vertices[lid];
+        double newloc[3] = {mb.target[0][lid], mb.target[1][lid], mb.target[2][lid]};
+        if (body >= 0) {
+          const double x[3] = {mb.x[0][lid], mb.x[1][lid], mb.x[2][lid]};
+          const double* const in[3] = {x, x + 1, x + 2};
+          double* const out[3] = {newloc, newloc + 1, newloc + 2};
+          applyRigidTransform(transforms[body], 1, in, out);
+          numStackMoves++;
+        }
+        if (!info.discrete) // parametric
+          MeshMover_setVolumeMove(mmover,meshVertex,newloc);
+        else // discrete, verts holds the whole closure
+          MeshMover_setDiscreteDeformMove(mmover,modelRegion,meshVertex,newloc);
+      }
+    }
+    PC_LOG_TOTAL(PC_LOG_INFO, "boundary layer stack vertices moved rigidly", numStackMoves);
+    PC_LOG(PC_LOG_DEBUG, "Starting loop over model faces and edges\n");
+    paramCache* params = getControl().paramWarmStart ? &getParamCache(cidx) : 0;
+    long numProjections = 0;
+    for (int d = 2; d >= 1; d--) {
+      for (size_t i = 0; i < cidx.entities[d].size(); i++) {
+        modelEntityInfo& info = cidx.entities[d][i];
+        if (info.rigidBody >= 0) {
+          assert(!info.discrete); // should be parametric geometry
+          continue;
+        }
+        if (info.discrete) continue; // moved with its discrete region
+        for (size_t j = 0; j < info.verts.size(); j++) {
+          int lid = info.verts[j];
+          if (!known[lid]) continue;
+          meshVertex = cidx.vertices[lid];
+          const double disp[3] = {mb.disp[0][lid], mb.disp[1][lid], mb.disp[2][lid]};
+          if (params) {
+            const double x[3] = {mb.x[0][lid], mb.x[1][lid], mb.x[2][lid]};
+            if (!movedParamPoint(*params, lid, meshVertex, info.ent, d, x, disp, newpar, newpt))
+              numProjections++;
+          }
+          else
+            V_movedParamPoint(meshVertex,disp,newpar,newpt);
+          MeshMover_setSurfaceMove(mmover,meshVertex,newpar,newpt);
+          PC_LOG_ALL(PC_LOG_TRACE, "surface move of vertex %d\n", EN_id(meshVertex));
+          numSurfaceMoves++;
+        }
+      }
+    }
+    PC_LOG_TOTAL(PC_LOG_INFO, "surface vertices moved", numSurfaceMoves);
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "surface vertices projected without a warm start", numProjections);
+    PC_LOG(PC_LOG_DEBUG, "Starting loop over model vertices\n");
+    for (size_t i = 0; i < cidx.entities[0].size(); i++) {
+      modelEntityInfo& info = cidx.entities[0][i];
+      if (info.rigidBody >= 0) {
+        assert(!info.discrete); // should be parametric geometry
+        continue;
+      }
+      if (info.discrete) continue;
+      for (size_t j = 0; j < info.verts.size(); j++) {
+        int lid = info.verts[j];
+        if (!known[lid]) continue;
+        PC_LOG_ALL(PC_LOG_TRACE, "model vertex at %e %e %e\n",
+            mb.x[0][lid], mb.x[1][lid], mb.x[2][lid]);
+        const double disp[3] = {mb.disp[0][lid], mb.disp[1][lid], mb.disp[2][lid]};
+        assert(sqrt(disp[0]*disp[0] + disp[1]*disp[1] + disp[2]*disp[2]) < 1e-10); // threshold 1e-10
+      }
+    }
+  }
+
+  /* the remaining motion from its current state to ft in substeps of
+     1/k of the whole, one mover each; when cooperating the solution
+     fields are mapped by an improver in every substep and the last one
+     also gets the adapter. A failed substep is retried from where it
+     stopped with twice the substeps, up to pcMaxSubsteps. Returns false
+     if the motion could not be finished */
+  static bool runSubsteps(ph::Input& in, apf::Mesh2* m, pParMesh ppm,
+      pGModel model, std::vector<int> const& rbTags, finalTargets const& ft,
+      std::vector<ph::rigidBodyMotion> const& rbms, int k, int cooperation,
+      pProgress progress) {
+    pMesh pm = PM_mesh(ppm,0);
+    double done = 0;
+    while (done < 1) {
+      double next = done + 1.0 / k;
+      bool last = next > 1 - 1e-12;
+      if (last)
+        next = 1;
+      PC_LOG(PC_LOG_INFO, "mesh motion substep from %f to %f of the motion\n", done, next);
+      pMeshMover sub = MeshMover_new(ppm, 0);
+      motionBuffer& mb = getMotionBuffer();
+      std::vector<char> known;
+      classificationIndex& sidx = gatherSubstep(m, model, pm, rbTags, ft,
+          (next - done) / (1 - done), mb, known);
+      setMoverMotion(m, sub, sidx, mb, known, substepMotions(rbms, done, next));
+      pPList sub_fld_lst = PList_new();
+      if (cooperation) {
+        if (last)
+          addAdapterInMover(sub, sub_fld_lst, in, m);
+        else if (in.solutionMigration) {
+          PList_delete(sub_fld_lst);
+          sub_fld_lst = getSimFieldList(in, m);
+        }
+        addImproverInMover(sub, sub_fld_lst);
+      }
+      int ok = MeshMover_run(sub, progress);
+      MeshMover_delete(sub);
+      PList_clear(sub_fld_lst);
+      PList_delete(sub_fld_lst);
+      if (cooperation) {
+        pc::markTopologyChanged();
+        /* the caller transfers the fields of the finished motion */
+        if (in.solutionMigration && !(ok && last))
+          transferSimFields(m);
+      }
+      if (ok) {
+        done = next;
+        continue;
+      }
+      if (2 * k > getControl().maxSubsteps) {
+        PC_LOG(PC_LOG_ERROR, "mesh mover failed at %f of the motion with %d substeps\n",
+            done, k);
+        return false;
+      }
+      k *= 2;
+      PC_LOG(PC_LOG_WARN, "mesh mover failed at %f of the motion, retrying with %d substeps\n",
+          done, k);
+    }
+    return true;
+  }
+
 // auto detect non-rigid body model entities
   bool updateSIMCoordAuto(ph::Input& in, apf::Mesh2* m, int cooperation) {
     if (in.writeSimLog)
@@ -456,17 +767,20 @@ if (pm) {
     pParMesh ppm = apf_msim->getMesh();
     pMesh pm = PM_mesh(ppm,0);
 
-    MS_reparameterizeForDiscrete(pm);
-    cout << "Reparameterizing for each adapt cycle" << endl;
-
     gmi_model* gmiModel = apf_msim->getModel();
     pGModel model = gmi_export_sim(gmiModel);
 
+    if (discreteModelChanged(model, pm)) {
+      MS_reparameterizeForDiscrete(pm);
+      PC_LOG(PC_LOG_DEBUG, "Reparameterizing for each adapt cycle\n");
+    }
 
-    apf::Field* f = m->findField("motion_coords");
-    assert(f);
-    apf::NewArray<double> vals(apf::countComponents(f));
-    assert(apf::countComponents(f) == 3);
+
+    /* the boundary exchange leaves the interior to the mover */
+    bool boundaryExchange = getControl().motionExchange == EXCHANGE_BOUNDARY;
+    apf::Field* f = boundaryExchange ? 0 : m->findField("motion_coords");
+    assert(f || boundaryExchange);
+    apf::NewArray<double> vals(3);
 /*
     apf::Field* f2 = m->findField("mesh_vel");
     assert(f2);
@@ -477,9 +791,6 @@ if (pm) {
 
     // declaration
     pGRegion modelRegion;
-    pGFace modelFace;
-    pGEdge modelEdge;
-    pGVertex modelVertex;
     VIter vIter;
     pVertex meshVertex;
     double newpt[3];
@@ -488,6 +799,13 @@ if (pm) {
 
     int hard_flag = 0 ;
 
+    /* what a failed single step mover needs to retry in substeps */
+    finalTargets ft;
+    std::vector<int> moverTags;
+    std::vector<ph::rigidBodyMotion> moverRbms;
+    bool canRetry = false;
+    int isRunMover = 1;
+
 /*
     //Debug Rane
     //1. Writing mesh as safety
@@ -506,182 +824,103 @@ if (pm) {
     cout<< tmp << endl;  
     sFile = fopen (tmp.c_str(), "w");
 */
-    // write id and displacement to file
-
-    int id;
-    id = 0;
-    vIter = M_vertexIter(pm);
-    while((meshVertex = VIter_next(vIter))){
-      apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-      apf::getComponents(f, vtx, 0, &vals[0]);
-//      apf::getComponents(f2, vtx, 0, &mesh_vel_vals[0]);
-      V_coord(meshVertex, xyz);
-      id = EN_id(meshVertex);
-//      fprintf(sFile, "%d ", id);
-//      for(int ii = 0; ii < 3; ii++) {
-//        fprintf(sFile, " %.16e", vals[ii]);
-//      }
-//      for(int ii = 0; ii < 3; ii++) {
-// 	fprintf(sFile, " %.16e", mesh_vel_vals[ii]);
- //     }
-//        fprintf(sFile, "\n");
-    }
-    VIter_delete(vIter);
-//    delete [] vals;
 
     // close file
 //    fclose (sFile);
         
 
     // start mesh mover
-    if(!PCU_Comm_Self())
-      printf("Start mesh mover\n");
+    PC_LOG(PC_LOG_INFO, "Start mesh mover\n");
     pMeshMover mmover = MeshMover_new(ppm, 0);
 
-    printf("In mesh mover");
+    PC_LOG(PC_LOG_DEBUG, "In mesh mover\n");
 
 
 
 
 
     if (hard_flag ==0){
-	    cout << "inside mesh motion setup" << endl;
-	    std::vector<ph::rigidBodyMotion> rbms;
-	    if (in.nRigidBody > 0) {
-	      core_get_rbms(rbms);
-	    }
-	    else {
-	      rbms.clear();
+	    PC_LOG(PC_LOG_DEBUG, "inside mesh motion setup\n");
+	    std::vector<ph::rigidBodyMotion> rbms = getStepRigidBodyMotions(in);
+	    std::vector<int> rbTags(rbms.size());
+	    for (size_t i = 0; i < rbms.size(); i++)
+	      rbTags[i] = rbms[i].tag;
+	    classificationIndex& cidx = getClassificationIndex(model, pm, rbTags);
+	    // gather motion_coords and coordinates once, in index order
+	    motionBuffer& mb = getMotionBuffer();
+	    mb.verts.resize(cidx.vertices.size());
+	    for (size_t i = 0; i < cidx.vertices.size(); i++)
+	      mb.verts[i] = reinterpret_cast<apf::MeshEntity*>(cidx.vertices[i]);
+	    std::vector<char> known(mb.size(), 1);
+	    if (boundaryExchange) {
+	      gatherCoordinates(m, mb);
+	      applyBoundaryDeltas(m, mb);
+	      apf::Field* full = m->findField("motion_coords");
+	      if (full)
+	        apf::destroyField(full);
+	      computeDisplacements(mb);
+	      for (size_t i = 0; i < mb.size(); i++)
+	        known[i] = EN_whatInType(cidx.vertices[i]) < 3;
 	    }
-	    // loop over model regions
-	    cout << "Starting loop over model regions" <<  endl;
-	    GRIter grIter = GM_regionIter(model);
-	    while((modelRegion=GRIter_next(grIter))){
-	      int id = isOnRigidBody(model, modelRegion, rbms);
-	      if(id >= 0) {
-		cout<< "Rigid body detected" << endl;
-		assert(!GEN_isDiscreteEntity(modelRegion)); // should be parametric geometry
-	/*
-		printf("set rigid body motion: region %d; disp = (%e,%e,%e); rotaxis = (%e,%e,%e); rotpt = (%e,%e,%e); rotang = %f; scale = %f\n",
-			GEN_tag(modelRegion), rbms[id].trans[0], rbms[id].trans[1], rbms[id].trans[2],
-			rbms[id].rotaxis[0], rbms[id].rotaxis[1], rbms[id].rotaxis[2],
-			rbms[id].rotpt[0], rbms[id].rotpt[1], rbms[id].rotpt[2],
-			rbms[id].rotang, rbms[id].scale);
-	*/
-		MeshMover_setTransform(mmover, modelRegion, rbms[id].trans, rbms[id].rotaxis,
-					   rbms[id].rotpt, rbms[id].rotang, rbms[id].scale);
+	    else
+	      gatherMotion(m, f, mb);
+	    /* vertices beyond the influence radius keep their place */
+	    std::vector<rigidBodyMotion> motions(rbms.size());
+	    for (size_t i = 0; i < rbms.size(); i++)
+	      motions[i] = toRigidBodyMotion(rbms[i]);
+	    std::vector<char> far;
+	    findFarVertices(m, motions, mb, far);
+	    for (size_t i = 0; i < far.size(); i++)
+	      if (far[i]) {
+	        for (int d = 0; d < 3; d++) {
+	          mb.target[d][i] = mb.x[d][i];
+	          mb.disp[d][i] = 0;
+	        }
+	        known[i] = 1;
 	      }
-	      else {
-		if (!GEN_isDiscreteEntity(modelRegion)) { // parametric
-		  vIter = M_classifiedVertexIter(pm, modelRegion, 0);
-		  while((meshVertex = VIter_next(vIter))){
-		    apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-		    apf::getComponents(f, vtx, 0, &vals[0]);
-		    const double newloc[3] = {vals[0], vals[1], vals[2]};
-		    MeshMover_setVolumeMove(mmover,meshVertex,newloc);
-		  }
-		  VIter_delete(vIter);
-		}
-		else { // discrete
-		  vIter = M_classifiedVertexIter(pm, modelRegion, 1);
-		  while((meshVertex = VIter_next(vIter))){
-		    apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-		    apf::getComponents(f, vtx, 0, &vals[0]);
-		    const double newloc[3] = {vals[0], vals[1], vals[2]};
-		    MeshMover_setDiscreteDeformMove(mmover,modelRegion,meshVertex,newloc);
-		  }
-		  VIter_delete(vIter);
-		}
+	    /* the compressed boundary layers are volume moves of this mover */
+	    blTargets blt;
+	    if (compressBLForGaps(in, m, blt))
+	      for (size_t i = 0; i < mb.size(); i++) {
+	        blTargets::const_iterator it = blt.find(mb.verts[i]);
+	        if (it == blt.end())
+	          continue;
+	        for (int d = 0; d < 3; d++) {
+	          mb.target[d][i] = it->second[d];
+	          mb.disp[d][i] = it->second[d] - mb.x[d][i];
+	        }
+	        known[i] = 2;
 	      }
+	    /* substeps need the interior targets for the prediction */
+	    int k = boundaryExchange ? 1 : countMotionSubsteps(m, cidx, mb, rbms);
+	    if (!boundaryExchange) {
+	      for (size_t i = 0; i < mb.size(); i++)
+	        ft.index[cidx.vertices[i]] = (int)i;
+	      for (int d = 0; d < 3; d++)
+	        ft.x[d] = mb.target[d];
+	      ft.prescribed.resize(mb.size());
+	      for (size_t i = 0; i < mb.size(); i++)
+	        ft.prescribed[i] = known[i] == 2;
+	      moverTags = rbTags;
+	      moverRbms = rbms;
+	      canRetry = true;
 	    }
-	    GRIter_delete(grIter);
-	    cout<< "Starting loop over model faces" << endl;
-	    // loop over model surfaces
-	    GFIter gfIter = GM_faceIter(model);
-	    while((modelFace=GFIter_next(gfIter))){
-	      int id = isOnRigidBody(model, modelFace, rbms);
-	      if(id >= 0) {
-		assert(!GEN_isDiscreteEntity(modelFace)); // should be parametric geometry
-		cout<< "Rigid body detected" << endl;
-		continue;
-	      }
-	      else {
-		if (!GEN_isDiscreteEntity(modelFace)) { // parametric
-		  vIter = M_classifiedVertexIter(pm, modelFace, 0);
-		  while((meshVertex = VIter_next(vIter))){
-		    V_coord(meshVertex, xyz);
-		    apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-		    apf::getComponents(f, vtx, 0, &vals[0]);
-		    const double disp[3] = {vals[0]-xyz[0], vals[1]-xyz[1], vals[2]-xyz[2]};
-		    cout<< "before V_movedParamPoint" << endl;
-		    V_movedParamPoint(meshVertex,disp,newpar,newpt);
-		    cout << "before Setting surface move" << endl;
-		    MeshMover_setSurfaceMove(mmover,meshVertex,newpar,newpt);
-		    cout << "after Setting surface move" << endl;
-		  }
-		  VIter_delete(vIter);
-		}
-	      }
+	    if (k == 1) {
+	      setMoverMotion(m, mmover, cidx, mb, known, rbms);
 	    }
-	    GFIter_delete(gfIter);
-	    cout << "Starting loop over model edges" << endl;
-	    // loop over model edges
-	    GEIter geIter = GM_edgeIter(model);
-	    while((modelEdge=GEIter_next(geIter))){
-	      int id = isOnRigidBody(model, modelEdge, rbms);
-	      if(id >= 0) {
-		assert(!GEN_isDiscreteEntity(modelEdge)); // should be parametric geometry
-		continue;
-	      }
-	      else {
-		if (!GEN_isDiscreteEntity(modelEdge)) { // parametric
-		  vIter = M_classifiedVertexIter(pm, modelEdge, 0);
-		  while((meshVertex = VIter_next(vIter))){
-		    V_coord(meshVertex, xyz);
-		    apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-		    apf::getComponents(f, vtx, 0, &vals[0]);
-		    const double disp[3] = {vals[0]-xyz[0], vals[1]-xyz[1], vals[2]-xyz[2]};
-		    V_movedParamPoint(meshVertex,disp,newpar,newpt);
-		    MeshMover_setSurfaceMove(mmover,meshVertex,newpar,newpt);
-		  }
-		  VIter_delete(vIter);
-		}
-	      }
-	    }
-	    GEIter_delete(geIter);
-	    cout << "Starting loop over model vertices" << endl;
-	    // loop over model vertices
-	    GVIter gvIter = GM_vertexIter(model);
-	    while((modelVertex=GVIter_next(gvIter))){
-	      int id = isOnRigidBody(model, modelVertex, rbms);
-	      if(id >= 0) {
-		assert(!GEN_isDiscreteEntity(modelVertex)); // should be parametric geometry
-		continue;
-	      }
-	      else {
-		if (!GEN_isDiscreteEntity(modelVertex)) { // parametric
-		  vIter = M_classifiedVertexIter(pm, modelVertex, 0);
-		  while((meshVertex = VIter_next(vIter))){
-		    V_coord(meshVertex, xyz);
-		    cout << xyz[0] << " " << xyz[1] << " " << xyz[2] << endl;
-		    apf::MeshEntity* vtx = reinterpret_cast<apf::MeshEntity*>(meshVertex);
-		    apf::getComponents(f, vtx, 0, &vals[0]);
-		    const double disp[3] = {vals[0]-xyz[0], vals[1]-xyz[1], vals[2]-xyz[2]};
-		    assert(sqrt(disp[0]*disp[0] + disp[1]*disp[1] + disp[2]*disp[2]) < 1e-10); // threshold 1e-10
-		  }
-		  VIter_delete(vIter);
-		}
-	      }
+	    else {
+	      MeshMover_delete(mmover);
+	      mmover = 0;
+	      isRunMover = runSubsteps(in, m, ppm, model, rbTags, ft, rbms, k,
+	          cooperation, progress);
 	    }
-	    GVIter_delete(gvIter);
-
-	cout<< "end setup" <<endl;
+	PC_LOG(PC_LOG_DEBUG, "end setup\n");
     }
     else if (hard_flag==1){
 
     
     double disp2[3];
-    cout<< "Hardcoded mesh motion activated"<<endl;
+    PC_LOG(PC_LOG_INFO, "Hardcoded mesh motion activated\n");
     pGEntity gr = GM_entityByTag(model, 3, 164);
     vIter = M_vertexIter(pm);
     while(meshVertex = VIter_next(vIter)){
@@ -714,7 +953,7 @@ if (pm) {
   }
   }
   else if (hard_flag==2){
-    cout<< "PHASTA mesh motion activated"<<endl;
+    PC_LOG(PC_LOG_INFO, "PHASTA mesh motion activated\n");
     pGEntity gr = GM_entityByTag(model, 3, 92);
     vIter = M_vertexIter(pm);
     while(meshVertex = VIter_next(vIter)){
@@ -732,14 +971,8 @@ if (pm) {
       } 
     }
   } else if (hard_flag==3){
-	    cout << "inside mesh motion setup3" << endl;
-            std::vector<ph::rigidBodyMotion> rbms;
-            if (in.nRigidBody > 0) {
-              core_get_rbms(rbms);
-            }
-            else {
-              rbms.clear();
-            }
+	    PC_LOG(PC_LOG_DEBUG, "inside mesh motion setup3\n");
+            std::vector<ph::rigidBodyMotion> rbms = getStepRigidBodyMotions(in);
 
 	    pMeshSizeHolder msh = MeshSizeHolder_new(pm, 1.0);
 /*	    double trans[3] = {0.01, 0, 0}; // no translation
@@ -748,16 +981,16 @@ if (pm) {
    	    double angle = 0.0; // no rotation
     	    double scale = 0.0; // scale inner region by half  */
 	    // loop over model regions
-	    cout << "Starting loop over model regions" <<  endl;
+	    PC_LOG(PC_LOG_DEBUG, "Starting loop over model regions\n");
 	    GRIter grIter = GM_regionIter(model);
 	    while((modelRegion=GRIter_next(grIter))){
 	      int id = isOnRigidBody(model, modelRegion, rbms);
-	      cout << "isOnRigiBody id: " << id << endl;
+	      PC_LOG_ALL(PC_LOG_DEBUG, "isOnRigiBody id: %d\n", id);
 	      if (id>=0){
-		cout << "trans info: " << rbms[id].trans[0] << endl;
+		PC_LOG_ALL(PC_LOG_DEBUG, "trans info: %e\n", rbms[id].trans[0]);
 		MeshMover_setTransform(mmover, modelRegion, rbms[id].trans, rbms[id].rotaxis, rbms[id].rotpt, rbms[id].rotang, rbms[id].scale);
 //	        MeshMover_setTransform(mmover, modelRegion, trans, axis, point, angle, scale);
-		cout<< "setTransform" << endl;
+		PC_LOG_ALL(PC_LOG_DEBUG, "setTransform\n");
 	      }else{
 		  vIter = M_classifiedVertexIter(pm, modelRegion, 0);
 		  while((meshVertex = VIter_next(vIter))){
@@ -772,64 +1005,66 @@ if (pm) {
     } //end else if hard_flag =3
  
 
-    cout<< "numRegions" <<  M_numRegions(pm) << endl;
+    PC_LOG_TOTAL(PC_LOG_DEBUG, "numRegions", M_numRegions(pm));
 
     // add mesh improver and solution transfer
     pPList sim_fld_lst = PList_new();
     PList_clear(sim_fld_lst);
-    if (cooperation) {
-      addAdapterInMover(mmover, sim_fld_lst, in, m);
-      addImproverInMover(mmover, sim_fld_lst);
-    }
+    if (mmover) {
+      if (cooperation) {
+        addAdapterInMover(mmover, sim_fld_lst, in, m);
+        addImproverInMover(mmover, sim_fld_lst);
+      }
 
 //    pMSAdapt msa = MeshMover_createAdapter(mmover);
 //    pVolumeMeshImprover vmi =  MeshMover_createImprover(mmover);
 
-    // do real work
-    if(!PCU_Comm_Self())
-      printf("do real mesh mover2\n");
-    int isRunMover = MeshMover_run(mmover, progress);
-    assert(isRunMover);
-    MeshMover_delete(mmover);
+      // do real work
+      PC_LOG(PC_LOG_INFO, "do real mesh mover2\n");
+      isRunMover = MeshMover_run(mmover, progress);
+      MeshMover_delete(mmover);
+      if (cooperation)
+        pc::markTopologyChanged();
+      if (!isRunMover && canRetry && getControl().maxSubsteps >= 2) {
+        PC_LOG(PC_LOG_WARN, "mesh mover failed, retrying with 2 substeps\n");
+        if (cooperation && in.solutionMigration)
+          pc::transferSimFields(m);
+        isRunMover = runSubsteps(in, m, ppm, model, moverTags, ft, moverRbms, 2,
+            cooperation, progress);
+      }
+    }
+    if (!isRunMover) {
+      PC_LOG(PC_LOG_ERROR, "mesh mover failed at step %d\n", in.timeStepNumber);
+      PList_delete(sim_fld_lst);
+      Progress_delete(progress);
+      return false;
+    }
 
 //    if(!PCU_Comm_Self())
 //      printf("write mesh: after_mover.sms\n");
 //    PM_write(ppm, "after_mover.sms", progress);
 //    M_write(pm, "after_mover2.sms", 0 ,progress);
-    cout << PCU_Comm_Self() << "PCU_COMM_Self" << endl;
+    PC_LOG_ALL(PC_LOG_DEBUG, "mesh mover done\n");
 
 
-    cout<< "numRegions" <<  M_numRegions(pm) << endl;
-    RIter rIter;
-    rIter = M_regionIter(pm);
-    int count_valid = 0;
-    int validity = 0;
-    double volume = 0;
-    pRegion meshRegion;
-
-    while(meshRegion = RIter_next(rIter)){
-	validity = R_isValidElement(meshRegion);
-	volume = R_volume(meshRegion);
-	if(validity<1 || volume <0)
-	  count_valid = count_valid+1;
-    }
-    RIter_delete(rIter);
-    cout <<" validity_count:" << count_valid << endl;	
+    pc::qualityReport quality;
+    pc::scanQuality(m, quality);
+    pc::printQualityReport(quality);
     
 
 
-    cout << "check validity of part" << PM_verify(ppm,0,progress) << endl;
+    pc::verifySIMMesh(ppm, in.timeStepNumber, progress);
     time_t now = time(0);
    
    // convert now to string form
     char* dt = ctime(&now);
-    cout << "The local date and time is: " << dt << endl;	
+    PC_LOG(PC_LOG_INFO, "The local date and time is: %s", dt);
 
     PList_clear(sim_fld_lst);
     PList_delete(sim_fld_lst);
 
     if (cooperation) {
-      // load balance    cout<< "mesh_written" << endl;
+      // load balance
       balanceEqualWeights(ppm, progress);
 
       // transfer sim fields to apf fields
@@ -838,23 +1073,17 @@ if (pm) {
     }
 
     // set rigid body total disp to be zero
-    for (size_t i_nrbs = 0; (int)i_nrbs < in.nRigidBody; i_nrbs++) {
-      for (size_t i_rbpd = 0; (int)i_rbpd < 3; i_rbpd++)
-        in.rbParamData[i_rbpd+i_nrbs*(size_t)in.nRBParam] = 0.0;
-      for (size_t i_rbpd = 12; (int)i_rbpd < 13; i_rbpd++)
-        in.rbParamData[i_rbpd+i_nrbs*(size_t)in.nRBParam] = 0.0;
-    }
+    resetRigidBodyTotals(in);
 
     // write model and mesh
-    if(!PCU_Comm_Self())
-      printf("write model and mesh after mesh modification\n");
-      writeSIMModel(model, in.timeStepNumber, "sim_model_");
+    PC_LOG(PC_LOG_INFO, "write model and mesh after mesh modification\n");
+      checkpointSIMModel(model, in.timeStepNumber, "sim_model_");
       if (cooperation)
-        writeSIMMesh(ppm, in.timeStepNumber, "sim_mesh_");
+        checkpointSIMMesh(ppm, in.timeStepNumber, "sim_mesh_");
       else
-        writeSIMMesh(ppm, in.timeStepNumber, "sim_moved_mesh_");
+        checkpointSIMMesh(ppm, in.timeStepNumber, "sim_moved_mesh_");
 
-    cout<< "mesh_written" << endl;
+    PC_LOG(PC_LOG_DEBUG, "mesh_written\n");
 
     Progress_delete(progress);
     return true;
@@ -862,28 +1091,128 @@ if (pm) {
 
 
 
+  /* a mover with transforms only: no vertex moves, substeps or improver,
+     it only carries the parametric model along. False, with nothing done,
+     if a region is discrete or the mover fails */
+  static bool updateSIMRigid(ph::Input& in, apf::Mesh2* m, int kind,
+      std::vector<rigidBodyMotion> const& rbms, rigidBodyMotion const& whole) {
+    apf::MeshSIM* apf_msim = dynamic_cast<apf::MeshSIM*>(m);
+    pParMesh ppm = apf_msim->getMesh();
+    pGModel model = gmi_export_sim(apf_msim->getModel());
+    pGRegion modelRegion;
+    GRIter grIter = GM_regionIter(model);
+    while((modelRegion=GRIter_next(grIter)))
+      if (GEN_isDiscreteEntity(modelRegion)) {
+        GRIter_delete(grIter);
+        return false;
+      }
+    GRIter_delete(grIter);
+    pProgress progress = Progress_new();
+    Progress_setDefaultCallback(progress);
+    pMeshMover mmover = MeshMover_new(ppm, 0);
+    grIter = GM_regionIter(model);
+    while((modelRegion=GRIter_next(grIter))){
+      rigidBodyMotion rbm = whole;
+      if (kind == MOTION_BODIES)
+        for (size_t i = 0; i < rbms.size(); i++)
+          if (rbms[i].tag == GEN_tag(modelRegion))
+            rbm = rbms[i];
+      MeshMover_setTransform(mmover, modelRegion, rbm.trans, rbm.rotaxis,
+          rbm.rotpt, rbm.rotang, rbm.scale);
+    }
+    GRIter_delete(grIter);
+    int isRunMover = MeshMover_run(mmover, progress);
+    MeshMover_delete(mmover);
+    if (!isRunMover) {
+      PC_LOG(PC_LOG_WARN, "transform only mesh mover failed, using the full mover\n");
+      Progress_delete(progress);
+      return false;
+    }
+    checkpointSIMModel(model, in.timeStepNumber, "sim_model_");
+    checkpointSIMMesh(ppm, in.timeStepNumber, "sim_moved_mesh_");
+    Progress_delete(progress);
+    return true;
+  }
+
+  /* the fast path of steps where the mesh moves as rigid pieces; false
+     if the mover is needed */
+  static bool moveRigidStep(ph::Input& in, apf::Mesh2* m) {
+    double t0 = PCU_Time();
+    std::vector<rigidBodyMotion> rbms = getRigidBodyMotions(in);
+    rigidBodyMotion whole;
+    int kind = findRigidMotion(m, rbms, whole);
+    if (kind == MOTION_GENERAL)
+      return false;
+    if (in.simmetrixMesh) {
+      if (!updateSIMRigid(in, m, kind, rbms, whole))
+        return false;
+    }
+    else if (kind == MOTION_BODIES) {
+      moveRigidBodies(m, rbms);
+      apf::synchronize(m->getCoordinateField());
+    }
+    else {
+      moveWholeMesh(m, makeRigidTransform(whole));
+    }
+    resetRigidBodyTotals(in);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_INFO, "moved the mesh %s without the mover in %f seconds\n",
+        kind == MOTION_BODIES ? "with its rigid bodies" : "as one rigid body", t1 - t0);
+    if (getControl().writeMotionVtk && !in.simmetrixMesh)
+      pc::writeSequence(m, in.timeStepNumber, "pvtu_mesh_");
+    return true;
+  }
+
   void runMeshMover(ph::Input& in, apf::Mesh2* m, int step, int cooperation) {
+    /* the adapter of a cooperating Simmetrix mover still has to run */
+    if (getControl().rigidFastPath && !(in.simmetrixMesh && cooperation) &&
+        moveRigidStep(in, m))
+      return;
     bool done = false;
     if (in.simmetrixMesh) {
       done = updateSIMCoordAuto(in, m, cooperation);
     }
+    else if (getControl().meshMover == MOVER_ELASTIC ||
+        getControl().motionExchange == EXCHANGE_BOUNDARY) {
+      /* copying coordinates needs the interior targets */
+      done = runElasticMover(in, m);
+    }
+    else if (getControl().meshMover == MOVER_RBF) {
+      done = runRbfMover(in, m);
+    }
     else {
       done = updateAPFCoord(in, m);
     }
-    assert(done);
+    if (!done) {
+      PC_LOG(PC_LOG_ERROR, "mesh motion failed at step %d\n", step);
+      abort();
+    }
+    if (!in.simmetrixMesh)
+      untangleMesh(m);
   }
 
   void updateMesh(ph::Input& in, apf::Mesh2* m, apf::Field* szFld, int step, int cooperation) {
+    if (pc::bypassMeshMotion(in,m)) {
+      pc::verifyMesh(m,step);
+      return;
+    }
     if (in.simmetrixMesh && cooperation) {
       pc::runMeshMover(in,m,step,cooperation);
-      m->verify();
+      pc::verifyMesh(m,step);
     }
     else {
       pc::runMeshMover(in,m,step);
-      m->verify();
-      pc::runMeshAdapter(in,m,szFld,step);
-      m->verify();
+      pc::verifyMesh(m,step);
+      if (pc::getControl().adaptOnInvalid && pc::isMeshValid(m)) {
+        PC_LOG(PC_LOG_INFO, "mesh valid after motion, adapt skipped\n");
+      }
+      else {
+        pc::runMeshAdapter(in,m,szFld,step);
+        pc::verifyMesh(m,step);
+      }
     }
+    if (pc::getControl().bypassThreshold > 0 && !in.simmetrixMesh)
+      pc::setMotionAnchor(m);
   }
 
 }
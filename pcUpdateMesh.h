@@ -51,6 +51,14 @@ namespace pc {
 
   meshMotion getTDMeshMotion(int caseId, int step);
 
+  /* zero the rigid body totals phasta accumulates between mesh updates */
+  void resetRigidBodyTotals(ph::Input& in);
+
+  /* chef::readAndAttachFields, which attaches every field phasta sent;
+     with pcMotionExchange boundary the full volume motion_coords is
+     destroyed right away, the mover does not use it */
+  void readAndAttachFields(ph::Input& in, apf::Mesh2*& m);
+
   bool updateAPFCoord(ph::Input& in, apf::Mesh2* m);
 
   bool updateAndWriteSIMDiscreteCoord(apf::Mesh2* m);
@@ -0,0 +1,220 @@
+#include "pcVerify.h"
+#include "pcControl.h"
+#include "pcClassification.h"
+#include "pcLog.h"
+#include <PCU.h>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace pc {
+
+  /* model and part boundary of the current topology, rebuilt whenever
+     the topology epoch changes */
+  struct boundaryCache {
+    boundaryCache(): epoch(-1), mesh(0), verified(0) {}
+    long epoch;
+    apf::Mesh* mesh;
+    apf::Mesh* verified;                 // mesh of the one full verification
+    size_t counts[4];
+    std::vector<apf::MeshEntity*> faces; // classified on model faces or shared
+    std::vector<int> upward;             // region count of each face
+    std::vector<int> modelDim;           // classification dimension of each face
+    std::vector<apf::MeshEntity*> shared; // shared vertices
+  };
+
+  static boundaryCache& getBoundaryCache() {
+    static boundaryCache c;
+    return c;
+  }
+
+  static void buildBoundaryCache(apf::Mesh* m, boundaryCache& c) {
+    int dim = m->getDimension();
+    c.mesh = m;
+    c.epoch = getTopologyEpoch();
+    for (int d = 0; d < 4; d++)
+      c.counts[d] = (d <= dim) ? m->count(d) : 0;
+    c.faces.clear();
+    c.upward.clear();
+    c.modelDim.clear();
+    c.shared.clear();
+    apf::MeshEntity* e;
+    apf::MeshIterator* itr = m->begin(dim-1);
+    while( (e = m->iterate(itr)) ) {
+      int md = m->getModelType(m->toModel(e));
+      if (md == dim && !m->isShared(e))
+        continue;
+      c.faces.push_back(e);
+      c.upward.push_back(m->countUpward(e));
+      c.modelDim.push_back(md);
+    }
+    m->end(itr);
+    itr = m->begin(0);
+    while( (e = m->iterate(itr)) )
+      if (m->isShared(e))
+        c.shared.push_back(e);
+    m->end(itr);
+  }
+
+  static long checkFaces(apf::Mesh* m, boundaryCache const& c) {
+    long bad = 0;
+    apf::Downward verts;
+    for (size_t i = 0; i < c.faces.size(); i++) {
+      apf::MeshEntity* f = c.faces[i];
+      if (m->countUpward(f) != c.upward[i]) {
+        PC_LOG_ALL(PC_LOG_DEBUG, "boundary face %lu lost an upward region\n", i);
+        bad++;
+        continue;
+      }
+      int nv = m->getDownward(f, 0, verts);
+      for (int v = 0; v < nv; v++)
+        if (m->getModelType(m->toModel(verts[v])) > c.modelDim[i]) {
+          PC_LOG_ALL(PC_LOG_DEBUG, "boundary face %lu has a vertex off its model entity\n", i);
+          bad++;
+          break;
+        }
+    }
+    return bad;
+  }
+
+  /* the boundary of a new topology, which has nothing to compare with:
+     a face has one or two regions, a part boundary face one, and no
+     vertex of a face is classified above it */
+  static long checkNewBoundary(apf::Mesh* m, boundaryCache const& c) {
+    int dim = m->getDimension();
+    long bad = 0;
+    apf::Downward verts;
+    for (size_t i = 0; i < c.faces.size(); i++) {
+      apf::MeshEntity* f = c.faces[i];
+      int maxUp = (c.modelDim[i] == dim) ? 1 : 2;
+      if (c.upward[i] < 1 || c.upward[i] > maxUp) {
+        PC_LOG_ALL(PC_LOG_DEBUG, "boundary face %lu has %d upward regions\n", i, c.upward[i]);
+        bad++;
+        continue;
+      }
+      int nv = m->getDownward(f, 0, verts);
+      for (int v = 0; v < nv; v++)
+        if (m->getModelType(m->toModel(verts[v])) > c.modelDim[i]) {
+          PC_LOG_ALL(PC_LOG_DEBUG, "boundary face %lu has a vertex off its model entity\n", i);
+          bad++;
+          break;
+        }
+    }
+    return bad;
+  }
+
+  /* every copy of a shared vertex must be at the same location */
+  static long checkSharedCoordinates(apf::Mesh* m, boundaryCache const& c) {
+    PCU_Comm_Begin();
+    apf::Vector3 p;
+    apf::Copies remotes;
+    for (size_t i = 0; i < c.shared.size(); i++) {
+      apf::MeshEntity* v = c.shared[i];
+      m->getPoint(v, 0, p);
+      remotes.clear();
+      m->getRemotes(v, remotes);
+      APF_ITERATE(apf::Copies, remotes, rit) {
+        PCU_COMM_PACK(rit->first, rit->second);
+        PCU_Comm_Pack(rit->first, &p[0], 3*sizeof(double));
+      }
+    }
+    PCU_Comm_Send();
+    long bad = 0;
+    while (PCU_Comm_Receive()) {
+      apf::MeshEntity* v;
+      double x[3];
+      PCU_COMM_UNPACK(v);
+      PCU_Comm_Unpack(x, sizeof x);
+      m->getPoint(v, 0, p);
+      double d = 0, s = 0;
+      for (int k = 0; k < 3; k++) {
+        d += (x[k] - p[k]) * (x[k] - p[k]);
+        s += p[k] * p[k];
+      }
+      if (sqrt(d) > 1e-12 * (1.0 + sqrt(s)))
+        bad++;
+    }
+    return bad;
+  }
+
+  long checkCheapInvariants(apf::Mesh* m) {
+    boundaryCache& c = getBoundaryCache();
+    assert(c.mesh == m && c.epoch == getTopologyEpoch());
+    long bad = 0;
+    for (int d = 0; d <= m->getDimension(); d++)
+      if (m->count(d) != c.counts[d]) {
+        PC_LOG_ALL(PC_LOG_DEBUG, "dimension %d entity count changed\n", d);
+        bad++;
+      }
+    bad += checkFaces(m, c);
+    bad += checkSharedCoordinates(m, c);
+    return PCU_Add_Long(bad);
+  }
+
+  static int lastStep = 0;
+  static int lastSampled = -1;
+
+  static bool isSampledStep(int step) {
+    control const& c = getControl();
+    if (step == lastSampled)
+      return true;
+    if (lastSampled < 0 || step - lastSampled >= c.verifyEvery) {
+      lastSampled = step;
+      return true;
+    }
+    return false;
+  }
+
+  void verifyMesh(apf::Mesh* m, int step) {
+    if (step < 0)
+      step = lastStep;
+    lastStep = step;
+    int level = getControl().verifyLevel;
+    if (level == VERIFY_OFF)
+      return;
+    if (level == VERIFY_SAMPLED && !isSampledStep(step))
+      return;
+    double t0 = PCU_Time();
+    boundaryCache& c = getBoundaryCache();
+    /* the cheap level verifies a mesh fully once, later topologies only
+       get the checks of their new boundary */
+    if (level == VERIFY_CHEAP && c.verified == m) {
+      long bad;
+      if (c.mesh == m && c.epoch == getTopologyEpoch())
+        bad = checkCheapInvariants(m);
+      else {
+        buildBoundaryCache(m, c);
+        bad = checkNewBoundary(m, c) + checkSharedCoordinates(m, c);
+        bad = PCU_Add_Long(bad);
+      }
+      if (bad) {
+        PC_LOG(PC_LOG_ERROR, "cheap mesh verification found %ld violations at step %d\n",
+            bad, step);
+        abort();
+      }
+      PC_LOG(PC_LOG_DEBUG, "cheap mesh verification in %f seconds\n", PCU_Time() - t0);
+      return;
+    }
+    m->verify();
+    if (level == VERIFY_CHEAP) {
+      buildBoundaryCache(m, c);
+      c.verified = m;
+    }
+    PC_LOG(PC_LOG_DEBUG, "full mesh verification in %f seconds\n", PCU_Time() - t0);
+  }
+
+  void verifySIMMesh(pParMesh ppm, int step, pProgress progress) {
+    if (step < 0)
+      step = lastStep;
+    int level = getControl().verifyLevel;
+    /* the cheap checks run on the apf wrapper through verifyMesh */
+    if (level == VERIFY_OFF || level == VERIFY_CHEAP)
+      return;
+    if (level == VERIFY_SAMPLED && !isSampledStep(step))
+      return;
+    int partValid = PM_verify(ppm, 0, progress);
+    PC_LOG_ALL(PC_LOG_DEBUG, "check validity of part %d\n", partValid);
+  }
+
+}
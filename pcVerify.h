@@ -0,0 +1,26 @@
+#ifndef PC_VERIFY_H
+#define PC_VERIFY_H
+
+#include <apf.h>
+#include <apfMesh2.h>
+#include <SimPartitionedMesh.h>
+
+namespace pc {
+
+  /* collective; verify m as the pcVerifyLevel policy asks for at this
+     step, entry points that do not know the step pass -1 to reuse the
+     step of the previous call */
+  void verifyMesh(apf::Mesh* m, int step);
+
+  /* collective; PM_verify at the full level and on sampled steps. The
+     cheap level skips it: the Simmetrix mesh only gets the boundary
+     checks verifyMesh runs on its apf wrapper */
+  void verifySIMMesh(pParMesh ppm, int step, pProgress progress);
+
+  /* collective O(boundary) checks against the boundary recorded for the
+     current topology, returns the global number of violations */
+  long checkCheapInvariants(apf::Mesh* m);
+
+}
+
+#endif
@@ -1,4 +1,6 @@
 #include "pcWriteFiles.h"
+#include "pcControl.h"
+#include "pcLog.h"
 #include "SimModel.h"
 #include "apfSIM.h"
 #include "apfMDS.h"
@@ -8,6 +10,11 @@
 #include <cassert>
 #include <algorithm>
 #include <math.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
 #include <SimPartitionedMesh.h>
 #include "SimModel.h"
 #include "SimUtil.h"
@@ -36,6 +43,179 @@ namespace pc {
     PM_write(mesh,tmp.c_str(),NULL);
   }
 
+  bool isCheckpointStep(int step) {
+    static int decidedStep = -1;
+    static int decision = 0;
+    static int cycles = 0;
+    static double lastTime = -1;
+    if (step == decidedStep)
+      return decision;
+    control const& c = getControl();
+    int due = 0;
+    if (!PCU_Comm_Self()) {
+      double now = PCU_Time();
+      if (lastTime < 0)
+        lastTime = now;
+      cycles++;
+      if (c.checkpointEvery > 0 && cycles >= c.checkpointEvery)
+        due = 1;
+      if (c.checkpointInterval > 0 && now - lastTime >= c.checkpointInterval)
+        due = 1;
+      if (due) {
+        cycles = 0;
+        lastTime = now;
+      }
+    }
+    decision = PCU_Max_Int(due);
+    decidedStep = step;
+    return decision;
+  }
+
+  /* rename, or copy and remove when staging is on another file system;
+     the staged file is kept if the copy fails */
+  static bool moveFile(std::string const& from, std::string const& to) {
+    if (!rename(from.c_str(), to.c_str()))
+      return true;
+    bool ok;
+    {
+      std::ifstream src(from.c_str(), std::ios::binary);
+      std::ofstream dst(to.c_str(), std::ios::binary);
+      ok = src && dst && (dst << src.rdbuf());
+      dst.close();
+      ok = ok && dst;
+    }
+    if (!ok) {
+      PC_LOG(PC_LOG_ERROR, "could not move checkpoint %s to %s, kept in staging\n",
+          from.c_str(), to.c_str());
+      return false;
+    }
+    remove(from.c_str());
+    return true;
+  }
+
+  /* staged files waiting to be moved by the rank 0 mover thread; the
+     collective writes stay on the calling thread, only the move of a
+     complete file overlaps the solver */
+  struct checkpointJob {
+    std::string staged;
+    std::string target;
+  };
+
+  static std::mutex ckptMutex;
+  static std::condition_variable ckptCond;
+  static std::deque<checkpointJob> ckptQueue;
+  static int ckptInFlight = 0;
+  static bool ckptStop = false;
+  static std::thread ckptThread;
+
+  static void checkpointWorker() {
+    for (;;) {
+      checkpointJob job;
+      {
+        std::unique_lock<std::mutex> lock(ckptMutex);
+        ckptCond.wait(lock, [] { return ckptStop || !ckptQueue.empty(); });
+        if (ckptQueue.empty())
+          return;
+        job = ckptQueue.front();
+        ckptQueue.pop_front();
+      }
+      moveFile(job.staged, job.target);
+      {
+        std::lock_guard<std::mutex> lock(ckptMutex);
+        ckptInFlight--;
+      }
+      ckptCond.notify_all();
+    }
+  }
+
+  /* rank 0 blocks until the in-flight bound allows one more staged
+     checkpoint */
+  static void waitForCheckpointSlot() {
+    if (PCU_Comm_Self())
+      return;
+    double t0 = PCU_Time();
+    std::unique_lock<std::mutex> lock(ckptMutex);
+    ckptCond.wait(lock, [] {
+      return ckptInFlight < getControl().checkpointInFlight; });
+    double t1 = PCU_Time();
+    if (t1 - t0 > 1.0)
+      PC_LOG(PC_LOG_INFO, "waited %f seconds for a checkpoint slot\n", t1 - t0);
+  }
+
+  /* rank 0 only; hand a complete staged file to the mover thread */
+  static void queueCheckpoint(std::string const& staged, std::string const& target) {
+    assert(!PCU_Comm_Self());
+    {
+      std::lock_guard<std::mutex> lock(ckptMutex);
+      checkpointJob job;
+      job.staged = staged;
+      job.target = target;
+      ckptQueue.push_back(job);
+      ckptInFlight++;
+    }
+    if (!ckptThread.joinable())
+      ckptThread = std::thread(checkpointWorker);
+    ckptCond.notify_all();
+  }
+
+  static std::string stepFileName(const char* filename, int step, const char* ext) {
+    std::ostringstream oss;
+    oss << filename << step << ext;
+    return oss.str();
+  }
+
+  void checkpointSIMModel (pGModel model, int step, const char* filename) {
+    if (!isCheckpointStep(step) || PCU_Comm_Self())
+      return;
+    std::string const& staging = getControl().checkpointStaging;
+    if (staging.empty()) {
+      writeSIMModel(model, step, filename);
+      return;
+    }
+    std::string target = stepFileName(filename, step, ".smd");
+    std::string staged = staging + "/" + target;
+    waitForCheckpointSlot();
+    GM_write(model,staged.c_str(),0,NULL);
+    queueCheckpoint(staged, target);
+  }
+
+  void checkpointSIMMesh (pParMesh mesh, int step, const char* filename) {
+    if (!isCheckpointStep(step))
+      return;
+    std::string const& staging = getControl().checkpointStaging;
+    if (staging.empty()) {
+      writeSIMMesh(mesh, step, filename);
+      return;
+    }
+    std::string target = stepFileName(filename, step, ".sms");
+    std::string staged = staging + "/" + target;
+    waitForCheckpointSlot();
+    double t0 = PCU_Time();
+    PM_write(mesh,staged.c_str(),NULL);
+    double t1 = PCU_Time();
+    PC_LOG(PC_LOG_DEBUG, "staged %s in %f seconds\n", target.c_str(), t1 - t0);
+    /* every part is in the file before it is moved */
+    PCU_Barrier();
+    if (!PCU_Comm_Self())
+      queueCheckpoint(staged, target);
+  }
+
+  void finishCheckpoints () {
+    if (!PCU_Comm_Self() && ckptThread.joinable()) {
+      double t0 = PCU_Time();
+      {
+        std::lock_guard<std::mutex> lock(ckptMutex);
+        ckptStop = true;
+      }
+      ckptCond.notify_all();
+      ckptThread.join();
+      ckptStop = false;
+      double t1 = PCU_Time();
+      PC_LOG(PC_LOG_INFO, "finished pending checkpoints in %f seconds\n", t1 - t0);
+    }
+    PCU_Barrier();
+  }
+
   void writePHTfiles (int old_step, int step, phSolver::Input& inp) {
     int nfields = 7;
     int ntout = min((int)inp.GetValue("Number of Timesteps between Restarts"),
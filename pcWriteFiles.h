@@ -16,6 +16,23 @@ namespace pc {
   void writeSIMMesh (pParMesh mesh, int step, const char* filename);
 
   void writePHTfiles (int old_step, int cur_step, phSolver::Input& inp);
+
+  /* collective; whether the checkpoint cadence asks for a checkpoint at
+     this step, decided once per step so model and mesh agree */
+  bool isCheckpointStep(int step);
+
+  /* checkpointed versions of writeSIMModel and writeSIMMesh, written
+     at the pcCheckpointEvery/pcCheckpointInterval cadence; the model is
+     written by rank 0. With a staging directory the files are written
+     there and a background thread on rank 0 moves each complete file
+     into the working directory while the solver runs, with at most
+     pcCheckpointInFlight files waiting */
+  void checkpointSIMModel (pGModel model, int step, const char* filename);
+
+  void checkpointSIMMesh (pParMesh mesh, int step, const char* filename);
+
+  /* collective; wait for all staged checkpoints to be moved */
+  void finishCheckpoints ();
 }
 
 #endif
@@ -0,0 +1,72 @@
+#include <PCU.h>
+#include "lionPrint.h"
+
+#include "pcQuality.h"
+#include "pcSizeEstimate.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* on regular tets the estimate from element volumes must match the
+   one from cur_size cubed it replaced */
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+  PCU_Comm_Init();
+  lion_set_verbosity(1);
+
+  const double edges[3] = {0.1, 0.2, 0.5};
+  const double unit[4][3] = {
+    {1, 1, 1}, {1, -1, -1}, {-1, 1, -1}, {-1, -1, 1}}; // edge 2 sqrt(2)
+  pc::elementCoords ec;
+  pc::currentSizes c;
+  c.regionTags.push_back(1);
+  c.vertStart.push_back(0);
+  ec.offset.push_back(0);
+  for (int e = 0; e < 3; e++) {
+    double s = edges[e] / (2.0 * sqrt(2.0));
+    ec.elms.push_back(0);
+    ec.type.push_back(apf::Mesh::TET);
+    for (int v = 0; v < 4; v++) {
+      for (int d = 0; d < 3; d++)
+        ec.xyz.push_back(s * unit[v][d] + e);
+      c.verts.push_back(4*e + v);
+    }
+    ec.offset.push_back(ec.offset.back() + 4);
+    c.vertStart.push_back(c.verts.size());
+    c.h.push_back(sqrt(2.0) * edges[e]);
+    c.vol.push_back(pc::elementTotalVolume(ec, e));
+    c.bl.push_back(0);
+    c.region.push_back(0);
+  }
+  c.numVerts = c.verts.size();
+
+  std::vector<double> h[3];
+  for (int d = 0; d < 3; d++)
+    for (size_t i = 0; i < c.numVerts; i++)
+      h[d].push_back(0.05 * (1 + d) * (1 + i % 3));
+  pc::sizeEstimate est = pc::estimateAdaptedElements(c, h);
+
+  double expected = 0;
+  for (size_t e = 0; e < c.h.size(); e++) {
+    double mean = 0;
+    for (int j = c.vertStart[e]; j < c.vertStart[e+1]; j++) {
+      int v = c.verts[j];
+      mean += 1.0 / (h[0][v] * h[1][v] * h[2][v]);
+    }
+    mean /= 4;
+    expected += c.h[e] * c.h[e] * c.h[e] * mean;
+  }
+  expected = PCU_Add_Double(expected);
+  int failed = fabs(est.total - expected) > 1e-9 * expected;
+  if (failed)
+    fprintf(stderr, "FAILED: estimated %.12g elements, cur_size cubed gives %.12g\n",
+        est.total, expected);
+  failed = PCU_Max_Int(failed);
+  if (!failed && !PCU_Comm_Self())
+    printf("size estimate %f matches cur_size cubed\n", est.total);
+
+  PCU_Comm_Free();
+  MPI_Finalize();
+  return failed;
+}
@@ -31,6 +31,8 @@
 #include "pcWriteFiles.h"
 #include "pcUpdateMesh.h"
 #include "pcAdapter.h"
+#include "pcControl.h"
+#include "pcVerify.h"
 
 #include <cstring>
 #include <cassert>
@@ -308,6 +310,7 @@ int main(int argc, char** argv) {
   ph::Input dst_ctrl;
   ctrl.load("adapt.inp");
   dst_ctrl.load("adapt.inp");
+  pc::loadControl("adapt.inp");
   chefPhasta::initModelers(ctrl.writeSimLog);
   dst_ctrl.attributeFileName = attribFilename;
   dst_ctrl.meshFileName = meshFilename;
@@ -317,14 +320,14 @@ int main(int argc, char** argv) {
   gmi_model* dst_g = 0;
   apf::Mesh2* dst_m = 0;
   chef::cook(dst_g, dst_m, dst_ctrl, dst_grs); // used to load model and mesh
-  dst_m->verify();
+  pc::verifyMesh(dst_m,0);
 
   gmi_model* g = 0;
   apf::Mesh2* m = 0;
   int step = ctrl.timeStepNumber;
   setupChef(ctrl, step);
   chef::cook(g, m, ctrl, grs); // used to load model and mesh
-  m->verify();
+  pc::verifyMesh(m,step);
 
   ctrl.rs = rs;
   dst_ctrl.rs = dst_rs;
@@ -337,7 +340,7 @@ int main(int argc, char** argv) {
   /* update model and write new model */
 //  pc::runMeshMover(ctrl,m,step);
   pc::updateAPFCoord(ctrl,m);
-  m->verify();
+  pc::verifyMesh(m,step);
 
   /* project solution to new mesh */
   projectAndAttachFields(m, dst_m);
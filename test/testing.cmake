@@ -29,6 +29,20 @@ if( ${phastaIC_FOUND} )
     -P ${CMAKE_CURRENT_SOURCE_DIR}/runphasta.cmake
     )
   
+  set(casename ${testLabel}_motionSchedule)
+  add_test(NAME ${casename}
+    COMMAND ${MPIRUN} ${MPIRUN_PROCFLAG} 1
+    ${PHASTACHEF_BINARY_DIR}/motionScheduleTest
+    WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
+    )
+
+  set(casename ${testLabel}_sizeEstimate)
+  add_test(NAME ${casename}
+    COMMAND ${MPIRUN} ${MPIRUN_PROCFLAG} 1
+    ${PHASTACHEF_BINARY_DIR}/sizeEstimateTest
+    WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
+    )
+
   set(casename ${testLabel}_loopStreamUR_incompressible)
   add_test(NAME ${casename}
     COMMAND ${CMAKE_COMMAND}
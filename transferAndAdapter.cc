@@ -31,6 +31,8 @@
 #include "pcWriteFiles.h"
 #include "pcUpdateMesh.h"
 #include "pcAdapter.h"
+#include "pcControl.h"
+#include "pcVerify.h"
 
 #include <cstring>
 #include <cassert>
@@ -189,6 +191,7 @@ int main(int argc, char** argv) {
   grstream grs = makeGRStream();
   ph::Input ctrl;
   ctrl.load("adapt.inp");
+  pc::loadControl("adapt.inp");
   chefPhasta::initModelers(ctrl.writeSimLog);
 
   /* load the model and mesh */
@@ -197,7 +200,7 @@ int main(int argc, char** argv) {
   int step = ctrl.timeStepNumber;
   setupChef(ctrl, step);
   chef::cook(g, m, ctrl, grs);
-  m->verify();
+  pc::verifyMesh(m,step);
 
   /* take the initial mesh as size field */
   apf::Field* szFld = samSz::isoSize(m);
@@ -209,7 +212,7 @@ int main(int argc, char** argv) {
   clearGRStream(grs);
 
   /* transfer fields to mesh */
-  chef::readAndAttachFields(ctrl,m);
+  pc::readAndAttachFields(ctrl,m);
 
   /* update model and write new model */
   if(modeId == 0) {
@@ -229,6 +232,7 @@ int main(int argc, char** argv) {
   destroyGRStream(grs);
   destroyRStream(rs);
   freeMesh(m);
+  pc::finishCheckpoints();
   chefPhasta::finalizeModelers(ctrl.writeSimLog);
   PCU_Comm_Free();
   MPI_Finalize();